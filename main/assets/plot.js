@@ -0,0 +1,191 @@
+/*
+ * plot.js - minimal canvas line plotter for the bed monitor dashboard, used
+ * in place of Chart.js (which is only embedded in the firmware on request).
+ * Usage:
+ *  const plot = new Plot(canvas, { capacity, xStep, title, xLabel, yLabel });
+ *  plot.set(values); // replace data (oldest first)
+ *  plot.push(value); // append, dropping the oldest beyond capacity
+ * Data is kept in a Float32Array ring, decimated with LTTB to the canvas
+ * width and redrawn at most once per animation frame. The x axis shows
+ * the time relative to the latest value (i.e. 0 = now).
+ */
+'use strict';
+
+/*
+ * lttb(get, n, m, out)
+ *  Largest-Triangle-Three-Buckets decimation of n evenly spaced points.
+ *  Inputs:
+ *   - get : Function returning the i-th value.
+ *   - n   : Number of points.
+ *   - m   : Number of points to keep (>= 3).
+ *   - out : Int32Array (length >= min(n, m)) receiving the kept indices.
+ *  Output: Number of indices written.
+ */
+const lttb = (get, n, m, out) => {
+    if (m >= n) {
+        for (let i = 0; i < n; i++) out[i] = i;
+        return n;
+    }
+
+    const size = (n - 2) / (m - 2); // bucket size
+    let a = 0, count = 0;
+    out[count++] = 0;
+    for (let b = 0; b < m - 2; b++) {
+        /* average of the next bucket */
+        const next0 = Math.floor((b + 1) * size) + 1;
+        const next1 = Math.min(Math.floor((b + 2) * size) + 1, n);
+        let avgX = 0, avgY = 0, avgN = 0;
+        for (let i = next0; i < next1; i++) {
+            const y = get(i);
+            if (isNaN(y)) continue;
+            avgX += i; avgY += y; avgN++;
+        }
+        if (avgN) { avgX /= avgN; avgY /= avgN; }
+        else { avgX = next0; avgY = get(a); }
+
+        /* point in this bucket forming the largest triangle */
+        const start = Math.floor(b * size) + 1;
+        const end = Math.floor((b + 1) * size) + 1;
+        const ay = get(a);
+        let best = start, bestArea = -1;
+        for (let i = start; i < end; i++) {
+            const area = Math.abs(
+                (a - avgX) * (get(i) - ay) - (a - i) * (avgY - ay)
+            );
+            if (area > bestArea) { bestArea = area; best = i; }
+        }
+        out[count++] = a = best;
+    }
+    out[count++] = n - 1;
+    return count;
+};
+
+/*
+ * niceStep(range, ticks)
+ *  Picks a 1/2/5 x 10^k tick step covering a range in about `ticks` steps.
+ */
+const niceStep = (range, ticks) => {
+    const raw = range / ticks;
+    const mag = Math.pow(10, Math.floor(Math.log10(raw)));
+    const norm = raw / mag;
+    return mag * ((norm < 1.5) ? 1 : (norm < 3.5) ? 2 : (norm < 7.5) ? 5 : 10);
+};
+
+class Plot {
+    constructor(canvas, options) {
+        this.canvas = (typeof canvas == 'string')
+            ? document.getElementById(canvas) : canvas;
+        this.capacity = options.capacity || 1000;
+        this.xStep = options.xStep || 1; // x distance between values
+        this.title = options.title || '';
+        this.xLabel = options.xLabel || '';
+        this.yLabel = options.yLabel || '';
+        this.color = options.color || 'steelblue';
+
+        this.values = new Float32Array(this.capacity); // ring buffer
+        this.head = 0; // index of oldest value
+        this.length = 0;
+        this.indices = new Int32Array(this.capacity); // decimation output
+        this.dirty = false;
+        this.get = (i) => this.values[(this.head + i) % this.capacity];
+        window.addEventListener('resize', () => this.update());
+    }
+
+    set(values) {
+        const n = Math.min(values.length, this.capacity);
+        const skip = values.length - n;
+        for (let i = 0; i < n; i++) this.values[i] = values[skip + i];
+        this.head = 0; this.length = n;
+        this.update();
+    }
+
+    push(value) {
+        if (this.length < this.capacity)
+            this.values[(this.head + this.length++) % this.capacity] = value;
+        else {
+            this.values[this.head] = value;
+            this.head = (this.head + 1) % this.capacity;
+        }
+        this.update();
+    }
+
+    update() {
+        if (this.dirty) return;
+        this.dirty = true;
+        requestAnimationFrame(() => this.draw());
+    }
+
+    draw() {
+        this.dirty = false;
+        const canvas = this.canvas, dpr = window.devicePixelRatio || 1;
+        const w = canvas.clientWidth, h = canvas.clientHeight;
+        if (canvas.width != w * dpr || canvas.height != h * dpr) {
+            canvas.width = w * dpr; canvas.height = h * dpr;
+        }
+        const ctx = canvas.getContext('2d');
+        ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+        ctx.clearRect(0, 0, w, h);
+        ctx.font = '12px sans-serif';
+        ctx.fillStyle = 'dimgray';
+
+        /* plot area */
+        const left = 56, right = w - 12, top = 28, bottom = h - 36;
+        ctx.textAlign = 'center'; ctx.textBaseline = 'top';
+        ctx.fillText(this.title, w / 2, 4);
+        ctx.fillText(this.xLabel, (left + right) / 2, h - 14);
+        ctx.save();
+        ctx.translate(12, (top + bottom) / 2); ctx.rotate(-Math.PI / 2);
+        ctx.fillText(this.yLabel, 0, -6);
+        ctx.restore();
+        if (right <= left || bottom <= top) return;
+
+        /* ranges */
+        const n = this.length;
+        let min = Infinity, max = -Infinity;
+        for (let i = 0; i < n; i++) {
+            const y = this.get(i);
+            if (y < min) min = y;
+            if (y > max) max = y;
+        }
+        if (min > max) { min = 0; max = 1; } // no data
+        if (min == max) { min -= 0.5; max += 0.5; }
+        const yStep = niceStep(max - min, 5);
+        min = Math.floor(min / yStep) * yStep;
+        max = Math.ceil(max / yStep) * yStep;
+        const span = Math.max(n - 1, 1) * this.xStep;
+        const xStep = niceStep(span, 6);
+        const px = (x) => right - x / span * (right - left); // x = age
+        const py = (y) => bottom - (y - min) / (max - min) * (bottom - top);
+
+        /* grid and ticks */
+        ctx.strokeStyle = 'gainsboro'; ctx.lineWidth = 1;
+        ctx.beginPath();
+        ctx.textAlign = 'right'; ctx.textBaseline = 'middle';
+        for (let y = min; y <= max + yStep / 2; y += yStep) {
+            ctx.moveTo(left, py(y)); ctx.lineTo(right, py(y));
+            ctx.fillText(+y.toFixed(6), left - 6, py(y));
+        }
+        ctx.textAlign = 'center'; ctx.textBaseline = 'top';
+        for (let x = 0; x <= span; x += xStep) {
+            ctx.moveTo(px(x), top); ctx.lineTo(px(x), bottom);
+            ctx.fillText(x ? -x : 0, px(x), bottom + 4);
+        }
+        ctx.stroke();
+
+        /* data (decimated to about one point per pixel) */
+        const count = lttb(
+            this.get, n, Math.max(Math.floor(right - left), 3), this.indices
+        );
+        ctx.strokeStyle = this.color; ctx.lineWidth = 1.5;
+        ctx.beginPath();
+        let pen = false;
+        for (let k = 0; k < count; k++) {
+            const i = this.indices[k], y = this.get(i);
+            if (isNaN(y)) { pen = false; continue; }
+            const x = px((n - 1 - i) * this.xStep);
+            if (pen) ctx.lineTo(x, py(y));
+            else { ctx.moveTo(x, py(y)); pen = true; }
+        }
+        ctx.stroke();
+    }
+}
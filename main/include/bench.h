@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+
+/*
+ * Microbenchmarks for the sensing and serialisation hot paths. The portable
+ * cases (bench_cases.c) run both on target, timed with the CPU cycle
+ * counter, and on the host (tools/bench), timed with a monotonic clock;
+ * the target additionally benchmarks the ADC path. Each result is printed
+ * as one JSON line, e.g.:
+ *  {"bench":"fsr_calc_FSR402","platform":"esp32","iters":10000,
+ *   "ns":1234.5,"cycles":197.5}
+ * so that runs can be compared against a stored baseline (see benchcmp in
+ * tools/bench). Cases are compared relative to the BENCH_CALIBRATION case
+ * of the same run, so that a baseline holds across machines of a platform.
+ */
+
+/* run benchmarks after boot - set in menuconfig ("Bed monitor") */
+#ifdef CONFIG_BED_BENCH
+#define BENCH_ENABLE                1
+#else
+#define BENCH_ENABLE                0
+#endif
+#define BENCH_REPEATS               5 // runs per case (fastest is reported)
+    // NOTE: taking the fastest run discards preemption by other tasks
+#define BENCH_CALIBRATION           "calibrate" // reference case name
+
+/* benchmark case */
+struct bench_case {
+    const char *name; // case name (unique within a platform)
+    void (*run)(uint32_t iters); // runs the case iters times
+    uint32_t iters; // iterations per run (each run must take < 4 s)
+};
+
+extern const struct bench_case bench_portable_cases[]; // portable cases
+extern const size_t bench_num_portable_cases;
+
+/*
+ * uint32_t bench_clock()
+ *  Reads the platform's benchmark clock (provided per platform).
+ *  Inputs: None.
+ *  Output: The clock value in ticks (CPU cycles on target, ns on host).
+ */
+uint32_t bench_clock();
+
+/*
+ * void bench_report(const char *name, uint32_t iters, uint32_t ticks)
+ *  Prints a benchmark result as a JSON line (provided per platform).
+ *  Inputs:
+ *   - name  : The case name.
+ *   - iters : The number of iterations.
+ *   - ticks : The duration of the iterations in bench_clock() ticks.
+ *  Output: None.
+ */
+void bench_report(const char *name, uint32_t iters, uint32_t ticks);
+
+/*
+ * void bench_run_cases(const struct bench_case *cases, size_t num)
+ *  Runs benchmark cases BENCH_REPEATS times each and reports the fastest
+ *  run of each.
+ *  Inputs:
+ *   - cases : The cases.
+ *   - num   : The number of cases.
+ *  Output: None.
+ */
+void bench_run_cases(const struct bench_case *cases, size_t num);
+
+/*
+ * void bench_run()
+ *  Runs all on-target benchmarks (only available with BENCH_ENABLE). The
+ *  sensing tasks keep running, so this measures the hot paths under their
+ *  real contention (e.g. for the ADC mutex).
+ *  Inputs: None.
+ *  Output: None.
+ */
+void bench_run();
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BOOT_MAX_STAGES             24 // max stages (event group bit count)
+#define BOOT_WORKERS                2 // number of tasks running stages
+#define BOOT_WORKER_STACK           4096 // stack size of helper workers
+
+/* boot stage definition */
+struct boot_stage {
+    const char *name; // stage name (for reporting)
+    void (*init)(); // stage function
+    uint32_t deps; // bitmask of stages (indices) that must finish first
+};
+
+/* boot milestones */
+enum boot_mark {
+    BOOT_MARK_FIRST_FORCE = 0, // first valid FSR sample taken
+    BOOT_MARK_FIRST_TEMP, // first valid temperature sample taken
+    BOOT_MARK_HTTPD, // web server accepting connections
+    BOOT_MARK_IP, // IP address acquired
+    BOOT_NUM_MARKS
+};
+
+/*
+ * void boot_run(const struct boot_stage *stages, size_t num_stages)
+ *  Runs the specified boot stages, each as soon as all of its dependencies
+ *  have finished, on up to BOOT_WORKERS tasks (the calling task included).
+ *  Stage start and end timestamps are recorded for boot_report().
+ *  Inputs:
+ *   - stages     : The boot stages. These must remain valid afterwards.
+ *   - num_stages : The number of stages (up to BOOT_MAX_STAGES).
+ *  Output: None (returns once all stages have finished).
+ */
+void boot_run(const struct boot_stage *stages, size_t num_stages);
+
+/*
+ * void boot_mark(enum boot_mark mark)
+ *  Records the time of a boot milestone. Only the first call for each
+ *  milestone is recorded, so this may be called repeatedly.
+ *  Inputs:
+ *   - mark : The milestone.
+ *  Output: None.
+ */
+void boot_mark(enum boot_mark mark);
+
+/*
+ * int64_t boot_get_mark(enum boot_mark mark)
+ *  Retrieves the time of a boot milestone.
+ *  Inputs:
+ *   - mark : The milestone.
+ *  Output: The time the milestone was reached (us since boot), or 0 if it
+ *          has not been reached yet.
+ */
+int64_t boot_get_mark(enum boot_mark mark);
+
+/*
+ * size_t boot_report(char *buf, size_t len)
+ *  Writes a JSON report of stage and milestone timestamps (in microseconds
+ *  since boot), along with the reset reason.
+ *  Inputs:
+ *   - buf : The output buffer.
+ *   - len : The output buffer's length.
+ *  Output: The length of the report (excluding null termination), which may
+ *          be larger than len if the report has been truncated.
+ */
+size_t boot_report(char *buf, size_t len);
@@ -2,24 +2,18 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include <freertos/FreeRTOS.h>
 
-/* FSR force curve - pairs of reference resistances and force values (g) */
-#define FSR_RESISTANCES \
-    100000, \
-    30000, 10000, 6000, 3500, /* interpolated */ 2000, \
-    1250, 750, 450, /* all interpolated */ \
-    300, 250 /* interpolated */
-#define FSR_FORCES \ 
-    16, /* interpolated */ \
-    20, 50, 100, 250, /* interpolated */ 500, \
-    1000, 2000, 4000, \
-    7000, 10000
+#include "sensor_models.h"
 
-#define FSR_MAX_FORCE               10000 // maximum rated force
-
-#define FSR_R_PD                    1000 // pulldown resistance
+/* sensor model (see sensor_models.h) */
+#define FSR_MODEL                   FSR402 // FSR model
+#define FSR_CALC                    SM_CAT(fsr_calc_, FSR_MODEL)
+    // conversion kernel for the model
+#define FSR_MAX_FORCE               SM_CAT(FSR_MAX_FORCE_, FSR_MODEL)
+    // maximum rated force
 
 /* pin config */
 #define FSR_PIN_CHANNEL             ADC_CHANNEL_7 // ADC channel of sense pin
@@ -35,7 +29,62 @@
 #define FSR_NUM_TAPS                5 // number of taps for signal trigger
 #define FSR_TAP_DURATION            2000 // duration (ms) for tap to be reg'd
 
-extern bool fsr_occupancy; // occupancy status
+/* raw force scope streaming */
+#define FSR_SCOPE_RING_LEN          256 // scope ring length (power of 2)
+#define FSR_SCOPE_BATCH             10 // samples per scope batch
+#define FSR_SCOPE_WITH_MV           1 // include ADC millivolts in samples
+
+/* scope sample */
+struct fsr_scope_sample {
+    uint16_t force; // force in grams (UINT16_MAX if reading failed)
+    uint16_t voltage; // ADC voltage in millivolts
+};
+
+/* sampling timing statistics */
+struct fsr_timing {
+    uint32_t samples; // samples taken since last reset
+    uint32_t late; // samples taken over one interval late
+    uint32_t max_jitter_us; // max deviation of sample interval (us)
+};
+
+/* force filter state (moving average and tap detection) */
+struct fsr_filter {
+    float avg_force; // average recorded force
+    int64_t last_tap; // timestamp (us) of last tap - for debouncing
+    bool started; // set once the first sample has been filtered
+};
+
+/*
+ * static inline bool fsr_filter_update(struct fsr_filter *filter,
+ *                                      float force, int64_t stamp)
+ *  Feeds a force sample into the exponential moving average and detects
+ *  (debounced) taps, i.e. sudden rises above the average. The average is
+ *  initialised with the first sample.
+ *  Inputs:
+ *   - filter : The filter state (zero-initialised before the first sample).
+ *   - force  : The force sample (g).
+ *   - stamp  : The sample's timestamp (us).
+ *  Output: Whether a tap was detected.
+ */
+static inline bool fsr_filter_update(struct fsr_filter *filter,
+                                     float force, int64_t stamp) {
+    if (!filter->started) {
+        filter->started = true;
+        filter->avg_force = force;
+    }
+
+    filter->avg_force = // exponential moving average
+        FSR_AVG_FACTOR * force + (1 - FSR_AVG_FACTOR) * filter->avg_force;
+
+    if (
+            force - filter->avg_force >= FSR_TAP_THRESHOLD
+        &&  stamp - filter->last_tap >= FSR_TAP_DEBOUNCE * 1000LL
+    ) {
+        filter->last_tap = stamp;
+        return true;
+    }
+    return false;
+}
 
 /*
  * void fsr_init()
@@ -53,3 +102,48 @@ void fsr_init();
  *  Output: The force measurement in grams, or NAN if reading failed.
  */
 float fsr_read(TickType_t max_wait);
+
+
+/*
+ * void fsr_scope_enable(bool enable)
+ *  Enables or disables pushing raw samples into the scope ring buffer. Any
+ *  samples left over from a previous session are discarded on enabling.
+ *  This must be called from the (single) scope consumer task.
+ *  Inputs:
+ *   - enable : Whether scope streaming is to be enabled.
+ *  Output: None.
+ */
+void fsr_scope_enable(bool enable);
+
+/*
+ * size_t fsr_scope_read(struct fsr_scope_sample *buf, size_t len,
+ *                       uint32_t *seq, uint32_t *dropped)
+ *  Pops a full batch of raw samples from the scope ring buffer. The ring is
+ *  lock-free with the sensing task as its only producer; when it is full, the
+ *  sensing task drops new samples rather than blocking.
+ *  Inputs:
+ *   - buf     : The output buffer.
+ *   - len     : The output buffer length (in samples). Up to this many
+ *               samples are popped, but only if at least FSR_SCOPE_BATCH
+ *               samples are available.
+ *   - seq     : Pointer to the output sequence number of the first sample.
+ *               This must be non-null.
+ *   - dropped : Pointer to the output number of samples dropped so far. This
+ *               must be non-null.
+ *  Output: The number of samples popped, which is 0 if no full batch is
+ *          available yet.
+ */
+size_t fsr_scope_read(struct fsr_scope_sample *buf, size_t len,
+                      uint32_t *seq, uint32_t *dropped);
+
+/*
+ * void fsr_get_timing(struct fsr_timing *timing, bool reset)
+ *  Retrieves the sampling timing statistics, i.e. how far the intervals
+ *  between samples deviated from FSR_INTERVAL.
+ *  Inputs:
+ *   - timing : Pointer to the statistics output. This may be NULL if the
+ *              statistics are only to be reset.
+ *   - reset  : Whether to reset the statistics afterwards.
+ *  Output: None.
+ */
+void fsr_get_timing(struct fsr_timing *timing, bool reset);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+#include "fsr.h"
+
+/*
+ * Update token - updates are rejected until a per-device token has been
+ * provisioned by storing a "token" string in the OTA_NVS_NAMESPACE
+ * namespace (e.g. flashed over serial along with the WiFi credentials)
+ */
+#define OTA_NVS_NAMESPACE           "ota" // NVS namespace for the token
+#define OTA_TOKEN_MIN_LEN           16 // min token length (characters)
+#define OTA_TOKEN_MAX_LEN           64 // max token length (characters)
+
+#define OTA_SHA256_LEN              32 // image hash length (bytes)
+#define OTA_SELFTEST_TIMEOUT        60000 // max time (ms) for self-test
+#define OTA_RESTART_DELAY           1000 // delay (ms) before restarting
+
+/* update report */
+struct ota_report {
+    uint32_t received; // bytes received (compressed if gzip)
+    uint32_t written; // image bytes written
+    uint32_t duration_ms; // time from ota_begin() to ota_end()
+    struct fsr_timing baseline; // FSR sampling timing before the update
+    struct fsr_timing during; // FSR sampling timing during the update
+};
+
+/*
+ * esp_err_t ota_check_token(const char *token)
+ *  Checks an update token against the one provisioned in NVS, in constant
+ *  time. This fails closed, i.e. no token is accepted until one (of at least
+ *  OTA_TOKEN_MIN_LEN characters) has been provisioned.
+ *  Inputs:
+ *   - token : The token (null-terminated).
+ *  Output: ESP_OK if the token matches, ESP_ERR_NOT_FOUND if no token has
+ *          been provisioned, or ESP_ERR_INVALID_ARG if it does not match.
+ */
+esp_err_t ota_check_token(const char *token);
+
+/*
+ * esp_err_t ota_begin(bool gzip, const uint8_t *sha256)
+ *  Starts an update into the inactive OTA partition. Flash sectors are
+ *  erased as they are written, so that sensing is never stalled by a whole
+ *  partition erase.
+ *  Inputs:
+ *   - gzip   : Whether the image is gzip compressed.
+ *   - sha256 : The expected SHA-256 hash of the (uncompressed) image.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+esp_err_t ota_begin(bool gzip, const uint8_t *sha256);
+
+/*
+ * esp_err_t ota_write(const void *data, size_t len)
+ *  Writes the next chunk of the image, decompressing it if needed. The image
+ *  hash is computed along the way.
+ *  Inputs:
+ *   - data : The chunk.
+ *   - len  : The chunk's length.
+ *  Output: ESP_OK on success, otherwise a corresponding error code (in which
+ *          case the update is to be aborted with ota_abort()).
+ */
+esp_err_t ota_write(const void *data, size_t len);
+
+/*
+ * esp_err_t ota_end(struct ota_report *report)
+ *  Finishes the update, verifying the image hash and validating the image
+ *  before setting it as the boot partition. The update is aborted on
+ *  failure.
+ *  Inputs:
+ *   - report : Pointer to the update report output. This may be NULL.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+esp_err_t ota_end(struct ota_report *report);
+
+/*
+ * void ota_abort()
+ *  Aborts the update in progress (if any).
+ *  Inputs: None.
+ *  Output: None.
+ */
+void ota_abort();
+
+/*
+ * void ota_self_test()
+ *  Runs the self-test if the running image has just been installed by an
+ *  update, i.e. waits for the unit's local health milestones (valid first
+ *  force and temperature samples, web server up - see enum boot_mark) to be
+ *  reached within OTA_SELFTEST_TIMEOUT. The image is marked valid if they
+ *  are, otherwise the previous image is restored and booted. The IP address
+ *  is not required, as it depends on the AP rather than on the image. This
+ *  is to be called after boot.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void ota_self_test();
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+
+/*
+ * Fixed-size buffer pools for steady-state operation without the heap.
+ * Buffers are reserved statically, so that serving clients cannot fragment
+ * the heap over time.
+ */
+
+/* buffer classes */
+enum pool_class {
+    POOL_FRAME = 0, // WebSocket frames
+    POOL_CHUNK, // HTTP response bodies/chunks
+    POOL_NUM_CLASSES
+};
+
+#define POOL_FRAME_SIZE             272 // frame buffer size (longest: T:)
+#define POOL_FRAME_COUNT            4 // number of frame buffers
+#define POOL_CHUNK_SIZE             1024 // response chunk buffer size
+#define POOL_CHUNK_COUNT            2 // number of response chunk buffers
+
+/*
+ * Steady-state allocation guard: 0 = disabled, 1 = count allocations made
+ * by guarded code after boot, 2 = also abort on such allocations (for test
+ * builds). This is set in menuconfig ("Bed monitor"), which also enables
+ * CONFIG_HEAP_USE_HOOKS, and is always disabled in host builds.
+ */
+#ifdef CONFIG_BED_POOL_ALLOC_GUARD
+#define POOL_ALLOC_GUARD            CONFIG_BED_POOL_ALLOC_GUARD
+#else
+#define POOL_ALLOC_GUARD            0
+#endif
+#define POOL_GUARD_MAX_TASKS        8 // max tasks in guarded sections
+
+/* pool statistics */
+struct pool_stats {
+    uint8_t in_use; // buffers currently in use
+    uint8_t peak; // max buffers in use at once
+    uint32_t failures; // failed pool_get() calls (pool exhausted)
+};
+
+/* allocation guard statistics (all zero if the guard is disabled) */
+struct pool_guard_stats {
+    uint32_t allocs; // heap allocations since arming (any task)
+    uint32_t bytes; // bytes allocated since arming (any task)
+    uint32_t violations; // allocations in guarded sections since arming
+    const char *last_task; // task of last violation (NULL if none)
+    size_t last_size; // size of last violation
+};
+
+/*
+ * void *pool_get(enum pool_class cls)
+ *  Takes a buffer from a pool. This never blocks, and is safe to call from
+ *  any task.
+ *  Inputs:
+ *   - cls : The buffer class.
+ *  Output: Pointer to the buffer, or NULL if the pool is exhausted.
+ */
+void *pool_get(enum pool_class cls);
+
+/*
+ * void pool_put(void *buf)
+ *  Returns a buffer taken with pool_get() to its pool.
+ *  Inputs:
+ *   - buf : The buffer. This may be NULL (in which case nothing is done).
+ *  Output: None.
+ */
+void pool_put(void *buf);
+
+/*
+ * size_t pool_size(enum pool_class cls)
+ *  Retrieves the size of buffers of the specified class.
+ *  Inputs:
+ *   - cls : The buffer class.
+ *  Output: The buffer size in bytes.
+ */
+size_t pool_size(enum pool_class cls);
+
+/*
+ * void pool_get_stats(enum pool_class cls, struct pool_stats *stats)
+ *  Retrieves the occupancy statistics of a pool.
+ *  Inputs:
+ *   - cls   : The buffer class.
+ *   - stats : Pointer to the statistics output. This must be non-null.
+ *  Output: None.
+ */
+void pool_get_stats(enum pool_class cls, struct pool_stats *stats);
+
+/*
+ * void pool_guard_arm()
+ *  Arms the allocation guard, to be called once boot has finished. From then
+ *  on, heap allocations are counted, and those made by tasks inside guarded
+ *  sections are reported as violations (see POOL_ALLOC_GUARD).
+ *  Inputs: None.
+ *  Output: None.
+ */
+void pool_guard_arm();
+
+/*
+ * void pool_guard_begin()
+ *  Enters a guarded section on the calling task, in which no heap allocations
+ *  are expected once boot has finished. Sections may be nested.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void pool_guard_begin();
+
+/*
+ * void pool_guard_end()
+ *  Leaves a guarded section entered with pool_guard_begin(). This may also be
+ *  used to lift the guard temporarily around calls into code outside our
+ *  control (e.g. the network stack).
+ *  Inputs: None.
+ *  Output: None.
+ */
+void pool_guard_end();
+
+/*
+ * void pool_guard_get_stats(struct pool_guard_stats *stats)
+ *  Retrieves the allocation guard statistics.
+ *  Inputs:
+ *   - stats : Pointer to the statistics output. This must be non-null.
+ *  Output: None.
+ */
+void pool_guard_get_stats(struct pool_guard_stats *stats);
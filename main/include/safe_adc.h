@@ -9,6 +9,13 @@
 
 // NOTE: only ADC1 is supported for now
 
+#define ADC_ATTEN                   ADC_ATTEN_DB_12 // attenuation for all ch.
+#define ADC_RAW_MAX                 4095 // max raw code (12-bit)
+
+/* raw code to voltage calibration cache */
+#define ADC_LUT_SEG_LEN             64 // codes per LUT segment
+#define ADC_LUT_VERIFY              1 // verify LUT against driver on init
+
 /*
  * void adc_init()
  *  Initialises the ESP32-C3's ADC peripheral in one-shot mode, as well as its
@@ -39,4 +46,37 @@ void adc_init_channel(adc_channel_t channel);
  *   - max_wait : The maximum mutex acquisition waiting duration in ticks.
  *  Output: ESP_OK on success.
  */
-esp_err_t adc_read(adc_channel_t channel, int *voltage, TickType_t max_wait);
\ No newline at end of file
+esp_err_t adc_read(adc_channel_t channel, int *voltage, TickType_t max_wait);
+
+/*
+ * esp_err_t adc_read_raw(adc_channel_t channel, int *raw, TickType_t max_wait)
+ *  Attempts to read the raw code of a specified ADC1 channel. Only the
+ *  conversion itself is done while holding the ADC mutex; callers may then
+ *  convert the code using adc_raw_to_mv() or their own lookup tables.
+ *  Inputs:
+ *   - channel  : The ADC1 channel number (0-7 corresponding to GPIO 32-39).
+ *   - raw      : Pointer to the raw code output (0 to ADC_RAW_MAX). This must
+ *                be non-null.
+ *   - max_wait : The maximum mutex acquisition waiting duration in ticks.
+ *  Output: ESP_OK on success.
+ */
+esp_err_t adc_read_raw(adc_channel_t channel, int *raw, TickType_t max_wait);
+
+/*
+ * int adc_raw_to_mv(int raw)
+ *  Converts a raw ADC code to a calibrated voltage using the calibration
+ *  cache built by adc_init(). This does not need the ADC mutex.
+ *  Inputs:
+ *   - raw : The raw code (0 to ADC_RAW_MAX).
+ *  Output: The voltage in millivolts, or -1 if conversion failed.
+ */
+int adc_raw_to_mv(int raw);
+
+/*
+ * esp_err_t adc_lut_verify()
+ *  Checks that the calibration cache agrees exactly with the calibration
+ *  driver for every raw code.
+ *  Inputs: None.
+ *  Output: ESP_OK if all codes match, or ESP_FAIL otherwise.
+ */
+esp_err_t adc_lut_verify();
\ No newline at end of file
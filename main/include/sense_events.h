@@ -10,6 +10,7 @@
 // NOTE: UI-facing temperature events are to be handled on frontend
 #define SE_OCC_UPDATE                           (1 << 1) // occupancy update
 #define SE_HELP                                 (1 << 2) // help signalling
+#define SE_SCOPE                                (1 << 3) // scope batch ready
 
 extern EventGroupHandle_t se_events; // shared event group for sensing events
 
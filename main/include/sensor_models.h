@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+ * Sensor model registry. Each supported FSR and thermistor model is
+ * described declaratively below, and a specialised conversion kernel with
+ * the model's parameters folded in as constants is generated for each:
+ *  - float fsr_calc_<model>(int voltage) : force (g) from pulldown voltage.
+ *  - float rt_calc_<model>(int voltage)  : temperature (C) from pulldown
+ *                                          voltage.
+ * A sensing channel is bound to a model at compile time (FSR_MODEL in fsr.h,
+ * RT_MODEL in thermistor.h) via FSR_CALC/RT_CALC, so the sample loop calls
+ * the kernel directly without any runtime dispatch.
+ * To add a model, add an entry to FSR_MODELS/RT_MODELS (and its curve).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <math.h>
+
+#include "vdiv.h" // voltage divider support
+
+/*
+ * FSR models - X(name, pulldown resistance, max rated force, curve), where
+ * the curve is a list of P(resistance, force (g)) reference points in order
+ * of decreasing resistance, linearly interpolated in between.
+ */
+#define FSR_MODELS(X) \
+    X(FSR402, 1000, 10000, FSR402_CURVE)
+
+/* Interlink FSR 402 (force curve from datasheet) */
+#define FSR402_CURVE(P) \
+    P(100000, 16) /* interpolated */ \
+    P(30000, 20) P(10000, 50) P(6000, 100) P(3500, 250) /* interpolated */ \
+    P(2000, 500) \
+    P(1250, 1000) P(750, 2000) P(450, 4000) /* all interpolated */ \
+    P(300, 7000) P(250, 10000) /* interpolated */
+
+/*
+ * Thermistor models - X(name, B constant, rated resistance, rated
+ * temperature (C), pulldown resistance).
+ */
+#define RT_MODELS(X) \
+    X(NTC3950_10K, 3950, 10000, 25, 10000)
+
+#define SM_T_KELVIN                 273.15 // 0C in Kelvin
+
+#define SM_CAT_(a, b)               a ## b
+#define SM_CAT(a, b)                SM_CAT_(a, b) // expands a and b first
+
+/* per-model constants, e.g. FSR_MAX_FORCE_FSR402 */
+#define SM_FSR_CONSTS(name, r_pd, max_force, curve) \
+    enum { FSR_MAX_FORCE_##name = max_force };
+FSR_MODELS(SM_FSR_CONSTS)
+
+#define SM_CURVE_R(r, f)            r,
+#define SM_CURVE_F(r, f)            f,
+
+/*
+ * static inline float fsr_calc_<name>(int voltage)
+ *  Calculates the applied force given an FSR's measurement.
+ *  Inputs:
+ *   - voltage : The measured voltage across the FSR's pulldown resistor in mV.
+ *  Output: The applied force in grams.
+ */
+#define SM_FSR_KERNEL(name, r_pd, max_force, curve) \
+static inline float fsr_calc_##name(int voltage) { \
+    static const float curve_R[] = { curve(SM_CURVE_R) }; \
+    static const float curve_F[] = { curve(SM_CURVE_F) }; \
+    const size_t num_segs = sizeof(curve_R) / sizeof(float) - 1; \
+    \
+    float R = calc_resistance(voltage, r_pd); /* calculate resistance */ \
+    if (R > curve_R[0]) return 0; /* measured resistance > max */ \
+    \
+    size_t seg = 0; /* curve segment index - [seg] to [seg + 1] */ \
+    while (seg < num_segs - 1 && R < curve_R[seg + 1]) seg++; \
+        /* NOTE: the last segment is extrapolated (and clamped below) */ \
+    \
+    /* linearly map R to F within the segment */ \
+    float slope = \
+            (curve_F[seg + 1] - curve_F[seg]) \
+        /   (curve_R[seg + 1] - curve_R[seg]); \
+    float F = curve_F[seg] + (R - curve_R[seg]) * slope; \
+    if (F > max_force) F = max_force; /* clamp force */ \
+    \
+    return F; \
+}
+FSR_MODELS(SM_FSR_KERNEL)
+
+/*
+ * static inline float rt_calc_<name>(int voltage)
+ *  Calculates the temperature given a thermistor's measurement.
+ *  Inputs:
+ *   - voltage : The measured voltage across the thermistor's pulldown
+ *               resistor in mV.
+ *  Output: The temperature in C.
+ */
+#define SM_RT_KERNEL(name, B, R0, t0, r_pd) \
+static inline float rt_calc_##name(int voltage) { \
+    float R = calc_resistance(voltage, r_pd); /* calculate resistance */ \
+    float T = 1 / (log(R / (R0)) / (B) + 1 / ((t0) + SM_T_KELVIN)); \
+        /* NOTE: see 5.2D task submission for explanation */ \
+    return T - SM_T_KELVIN; \
+}
+RT_MODELS(SM_RT_KERNEL)
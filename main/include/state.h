@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Shared sensor state, published by the sensing tasks and read by the web
+ * server (and anything else presenting the bed's state). Updates are
+ * published under a seqlock: writers are serialised among themselves, and
+ * readers copy the whole state without taking any lock, retrying only if
+ * an update landed mid-copy. Readers therefore never block the sensing
+ * tasks, and always get a coherent snapshot.
+ */
+
+/* state snapshot */
+struct st_snapshot {
+    uint32_t version; // number of updates published since boot
+    float temp; // latest temperature (C, NAN if none yet)
+    int64_t temp_stamp; // time (us since boot) of temperature reading
+    bool occupancy; // occupancy status
+    int64_t occ_stamp; // time (us since boot) of last occupancy change
+    bool help; // set while help is signalled
+    int64_t help_stamp; // time (us since boot) of last help change
+};
+
+/*
+ * void st_read(struct st_snapshot *snapshot)
+ *  Retrieves a coherent snapshot of the shared state.
+ *  Inputs:
+ *   - snapshot : Pointer to the snapshot output.
+ *  Output: None.
+ */
+void st_read(struct st_snapshot *snapshot);
+
+/*
+ * void st_set_temp(float temp)
+ *  Publishes a new temperature reading.
+ *  Inputs:
+ *   - temp : The temperature (C), or NAN if reading failed.
+ *  Output: None.
+ */
+void st_set_temp(float temp);
+
+/*
+ * void st_set_occupancy(bool occupancy)
+ *  Publishes the occupancy status.
+ *  Inputs:
+ *   - occupancy : Whether the bed is occupied.
+ *  Output: None.
+ */
+void st_set_occupancy(bool occupancy);
+
+/*
+ * void st_set_help(bool help)
+ *  Publishes the help signalling status.
+ *  Inputs:
+ *   - help : Whether help is signalled.
+ *  Output: None.
+ */
+void st_set_help(bool help);
@@ -6,11 +6,13 @@
 
 #include <freertos/FreeRTOS.h>
 
-/* thermistor parameters */
-#define RT_B                        3950 // B constant
-#define RT_R0                       10000 // rated resistance
-#define RT_t0                       25 // rated temperature (C)
-#define RT_R_PD                     10000 // pulldown resistor
+#include "tscomp.h"
+#include "sensor_models.h"
+
+/* sensor model (see sensor_models.h) */
+#define RT_MODEL                    NTC3950_10K // thermistor model
+#define RT_CALC                     SM_CAT(rt_calc_, RT_MODEL)
+    // conversion kernel for the model
 
 /* pin configuration */
 #define RT_PIN_CHANNEL              ADC_CHANNEL_6 // ADC channel of sense pin
@@ -22,9 +24,29 @@
 #define RT_LED_PERIOD               1000 // high temp LED blink period
 
 /* temperature history */
-#define RT_HISTORY_LEN              (24 * 60 / RT_SENSE_PERIOD) // entry count
-extern float rt_history[RT_HISTORY_LEN]; // initially filled with NAN
-extern float *rt_latest_temp; // latest reading (last element in history)
+#define RT_HISTORY_LEN              (3 * 24 * 60 / RT_SENSE_PERIOD)
+    // max number of entries to be sent to clients
+#define RT_HISTORY_SIZE             1152 // compressed history size (bytes)
+    // NOTE: this is the RAM taken by 1 day of uncompressed history
+extern struct ts_store rt_history; // compressed history (initially empty)
+
+/*
+ * void rt_history_lock()
+ *  Acquires exclusive access to the temperature history. This must be held
+ *  while reading rt_history, as appending may evict blocks; hold it only
+ *  briefly (e.g. to take a copy with ts_copy()), as rt_task waits on it.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void rt_history_lock();
+
+/*
+ * void rt_history_unlock()
+ *  Releases exclusive access to the temperature history.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void rt_history_unlock();
 
 /*
  * void rt_init()
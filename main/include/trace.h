@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace_hooks.h" // for TRACE_ENABLE
+
+/*
+ * Execution trace recorder. While armed, task switches, ADC conversions,
+ * event group sets and WebSocket sends are recorded into a fixed-size
+ * lock-free ring (overwriting the oldest records), so that it can be left
+ * running as a flight recorder and frozen (POST /trace/freeze) once an
+ * incident is noticed. The frozen recording is served by GET /trace in the
+ * binary format below and can be converted into Chrome/Perfetto trace JSON
+ * with tools/trace2json.
+ */
+
+#define TRACE_RING_LEN              2048 // ring length (records, power of 2)
+#define TRACE_ARM_AT_BOOT           0 // start recording at boot (1 = yes)
+#define TRACE_MAX_TASKS             32 // max tasks listed in a dump
+#define TRACE_TASK_NAME_LEN         16 // task name length in dumps
+    // NOTE: configMAX_TASK_NAME_LEN
+
+#define TRACE_MAGIC                 "BTRC" // dump magic number
+#define TRACE_VERSION               1 // dump format version
+
+/* record types */
+enum trace_type {
+    TRACE_TASK_IN = 0, // task switched in (arg = task handle)
+    TRACE_ADC_BEGIN, // ADC read started (arg16 = channel)
+    TRACE_ADC_END, // ADC read finished (arg16 = channel, arg = raw value)
+    TRACE_EVENT_SET, // event group bits set (arg = bits)
+    TRACE_WS_BEGIN, // WebSocket send started (arg16 = fd, arg = length)
+    TRACE_WS_END, // WebSocket send finished (arg16 = fd, arg = esp_err_t)
+    TRACE_NUM_TYPES
+};
+
+/*
+ * Dump format (little endian):
+ *  - struct trace_header
+ *  - num_tasks x struct trace_task
+ *  - num_records x struct trace_record, oldest first
+ */
+
+/* dump header */
+struct trace_header {
+    char magic[4]; // TRACE_MAGIC
+    uint8_t version; // TRACE_VERSION
+    uint8_t record_size; // sizeof(struct trace_record)
+    uint16_t num_tasks; // number of task entries
+    uint32_t num_records; // number of records
+    uint32_t total; // records taken since arming (incl. overwritten ones)
+};
+
+/* dump task entry */
+struct trace_task {
+    uint32_t handle; // task handle (as in TRACE_TASK_IN records)
+    char name[TRACE_TASK_NAME_LEN]; // task name (null-padded)
+};
+
+/* trace record */
+struct trace_record {
+    uint32_t stamp; // timestamp (us since boot, wraps every ~71 mins)
+    uint8_t type; // TRACE_x
+    uint8_t core; // CPU core
+    uint16_t arg16; // type-specific argument
+    uint32_t arg; // type-specific argument
+};
+
+#if TRACE_ENABLE
+
+/*
+ * void trace_init()
+ *  Initialises the trace recorder, arming it if TRACE_ARM_AT_BOOT is set.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void trace_init();
+
+/*
+ * void trace_record(uint8_t type, uint16_t arg16, uint32_t arg)
+ *  Records an event if the recorder is armed. This is lock-free and safe to
+ *  call from any task or ISR (it is placed in IRAM).
+ *  Inputs:
+ *   - type  : The record type (TRACE_x).
+ *   - arg16 : The 16-bit argument.
+ *   - arg   : The 32-bit argument.
+ *  Output: None.
+ */
+void trace_record(uint8_t type, uint16_t arg16, uint32_t arg);
+
+/*
+ * void trace_arm()
+ *  Discards any recording and starts recording. Records still being written
+ *  from before are waited for, so that none of them lands in the new
+ *  recording. This must be called from a task.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void trace_arm();
+
+/*
+ * bool trace_armed()
+ *  Retrieves whether the recorder is armed.
+ *  Inputs: None.
+ *  Output: Whether the recorder is armed.
+ */
+bool trace_armed();
+
+/*
+ * void trace_freeze()
+ *  Stops recording, waiting for records still being written. The recording
+ *  is kept until the recorder is armed again. This must be called from a
+ *  task.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void trace_freeze();
+
+/*
+ * size_t trace_dump(struct trace_header *header, struct trace_task *tasks)
+ *  Prepares a dump of the frozen recording (empty if the recorder is armed
+ *  or has never been).
+ *  Inputs:
+ *   - header : Pointer to the output dump header.
+ *   - tasks  : The output task entries (TRACE_MAX_TASKS entries).
+ *  Output: The number of records in the recording.
+ */
+size_t trace_dump(struct trace_header *header, struct trace_task *tasks);
+
+/*
+ * size_t trace_read(size_t first, struct trace_record *buf, size_t len)
+ *  Copies records out of the frozen recording (see trace_dump()).
+ *  Inputs:
+ *   - first : Index of the first record to copy (0 = oldest).
+ *   - buf   : The output buffer.
+ *   - len   : The max number of records to copy.
+ *  Output: The number of records copied.
+ */
+size_t trace_read(size_t first, struct trace_record *buf, size_t len);
+
+#else
+
+static inline void trace_init() {}
+static inline void trace_record(uint8_t type, uint16_t arg16, uint32_t arg) {
+    (void) type; (void) arg16; (void) arg;
+}
+
+#endif
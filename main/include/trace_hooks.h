@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * FreeRTOS trace hooks for the trace recorder (see trace.h). This header is
+ * force-included into every C source of the firmware build, including the
+ * kernel's (see the top-level CMakeLists.txt), so it must stay
+ * self-contained and cheap to include.
+ */
+
+#define TRACE_ENABLE                1 // compile in the trace recorder
+
+#if TRACE_ENABLE && defined(ESP_PLATFORM) && !defined(__ASSEMBLER__)
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#if !CONFIG_APPTRACE_SV_ENABLE // SystemView installs its own hooks
+
+/*
+ * void trace_task_switched_in()
+ *  Records the current task being switched in (called by the kernel).
+ *  Inputs: None.
+ *  Output: None.
+ */
+void trace_task_switched_in();
+
+/*
+ * void trace_event_group_set(uint32_t bits)
+ *  Records bits being set in an event group (called by the kernel).
+ *  Inputs:
+ *   - bits : The bits being set.
+ *  Output: None.
+ */
+void trace_event_group_set(uint32_t bits);
+
+#define traceTASK_SWITCHED_IN()     trace_task_switched_in()
+#define traceEVENT_GROUP_SET_BITS(group, bits) \
+    trace_event_group_set((uint32_t)(bits))
+
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Block-compressed time series storage. Samples are stored as 16-bit fixed
+ * point values; each block holds its first sample verbatim, followed by the
+ * delta-of-deltas of the remaining samples encoded as zigzag varints. Slowly
+ * changing signals (e.g. temperature) therefore take ~1 byte per sample.
+ * When the store is full, the oldest block is evicted.
+ * NOTE: this module is plain C with no ESP-IDF dependencies so that it can be
+ * benchmarked on the host (see tools/tsbench).
+ */
+
+#define TS_BLOCK_SIZE               64 // size of each block (in bytes)
+#define TS_SCALE                    100 // fixed point scale (0.01 units)
+#define TS_NAN                      INT16_MIN // fixed point value for NAN
+
+/* compressed block */
+struct ts_block {
+    int16_t first; // first sample in block
+    uint8_t count; // number of samples in block
+    uint8_t len; // number of used bytes in data
+    uint8_t data[TS_BLOCK_SIZE - 4]; // encoded delta-of-deltas
+};
+
+/* time series store */
+struct ts_store {
+    struct ts_block *blocks; // block ring buffer
+    size_t num_blocks; // number of blocks in ring buffer
+    size_t head; // index of oldest block
+    size_t used; // number of blocks in use
+    size_t count; // number of samples stored
+    int32_t last; // last appended sample (encoder state)
+    int32_t last_delta; // last delta between samples (encoder state)
+};
+
+/* streaming decoder state */
+struct ts_iter {
+    const struct ts_store *store; // store being decoded
+    size_t block; // current block (relative to head)
+    size_t sample; // index of next sample in current block
+    size_t pos; // read offset into current block's data
+    int32_t value; // last decoded sample
+    int32_t delta; // last decoded delta
+};
+
+/*
+ * void ts_init(struct ts_store *store, struct ts_block *blocks,
+ *              size_t num_blocks)
+ *  Initialises an empty time series store.
+ *  Inputs:
+ *   - store      : The store to be initialised.
+ *   - blocks     : Backing memory for the store's blocks.
+ *   - num_blocks : Number of blocks in the backing memory.
+ *  Output: None.
+ */
+void ts_init(struct ts_store *store, struct ts_block *blocks,
+             size_t num_blocks);
+
+/*
+ * void ts_append(struct ts_store *store, float value)
+ *  Appends a sample to the store, evicting the oldest block if needed.
+ *  Inputs:
+ *   - store : The store to append to.
+ *   - value : The sample to append. Values are rounded to 1/TS_SCALE and
+ *             saturated to the int16_t range; NAN is preserved.
+ *  Output: None.
+ */
+void ts_append(struct ts_store *store, float value);
+
+/*
+ * void ts_copy(struct ts_store *dst, struct ts_block *blocks,
+ *              const struct ts_store *src)
+ *  Copies a store, e.g. to decode a snapshot of it without holding a lock.
+ *  Inputs:
+ *   - dst    : The store to be initialised as a copy.
+ *   - blocks : Backing memory for the copy's blocks (as many blocks as the
+ *              source has).
+ *   - src    : The store to copy.
+ *  Output: None.
+ */
+void ts_copy(struct ts_store *dst, struct ts_block *blocks,
+             const struct ts_store *src);
+
+/*
+ * size_t ts_bytes_used(const struct ts_store *store)
+ *  Calculates the number of block bytes (incl. headers) holding samples.
+ *  Inputs:
+ *   - store : The store to query.
+ *  Output: The number of bytes used.
+ */
+size_t ts_bytes_used(const struct ts_store *store);
+
+/*
+ * void ts_iter_init(struct ts_iter *it, const struct ts_store *store)
+ *  Initialises a decoder positioned at the oldest sample in the store.
+ *  The store must not be modified while the decoder is in use.
+ *  Inputs:
+ *   - it    : The decoder to be initialised.
+ *   - store : The store to decode.
+ *  Output: None.
+ */
+void ts_iter_init(struct ts_iter *it, const struct ts_store *store);
+
+/*
+ * bool ts_iter_next(struct ts_iter *it, float *value)
+ *  Decodes the next sample.
+ *  Inputs:
+ *   - it    : The decoder.
+ *   - value : Pointer to the sample output. This must be non-null.
+ *  Output: true if a sample was decoded, or false if there are none left.
+ */
+bool ts_iter_next(struct ts_iter *it, float *value);
+
+/*
+ * size_t ts_iter_skip(struct ts_iter *it, size_t n)
+ *  Skips up to n samples, bypassing whole blocks without decoding them where
+ *  possible.
+ *  Inputs:
+ *   - it : The decoder.
+ *   - n  : The number of samples to skip.
+ *  Output: The number of samples actually skipped.
+ */
+size_t ts_iter_skip(struct ts_iter *it, size_t n);
+
+#define TS_FORMAT_MAX_LEN           8 // max formatted length of a sample
+    // including its leading comma
+
+/*
+ * size_t ts_format(struct ts_iter *it, char *buf, size_t max, bool comma,
+ *                  size_t *count)
+ *  Decodes up to max samples and formats them as comma-separated text with
+ *  two decimal places (e.g. "36.50,36.48"), skipping NAN samples.
+ *  Inputs:
+ *   - it    : The decoder.
+ *   - buf   : The output buffer, which must have room for
+ *             TS_FORMAT_MAX_LEN * max + 1 bytes (null-terminated).
+ *   - max   : The max number of samples to format.
+ *   - comma : Whether to precede the first sample with a comma (i.e. this
+ *             continues an earlier list).
+ *   - count : Pointer to the output number of samples formatted. This must
+ *             be non-null. Fewer than max means the samples ran out.
+ *  Output: The length of the formatted text.
+ */
+size_t ts_format(struct ts_iter *it, char *buf, size_t max, bool comma,
+                 size_t *count);
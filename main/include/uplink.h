@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Upstream push of sensing records to a central MQTT broker. Records are
+ * queued in RAM and published in batches to UL_TOPIC_PREFIX<unit>/records,
+ * where <unit> is the station MAC address (12 hex digits). Records stay
+ * queued until the broker acknowledges them, so they survive broker and
+ * network outages (up to UL_QUEUE_LEN records, after which the oldest are
+ * dropped).
+ * NOTE: this header is shared with host tools (see tools/uldump), so it must
+ * not depend on ESP-IDF.
+ */
+
+#define UL_BROKER_URI               "mqtt://192.168.1.2:1883" // MQTT broker
+#define UL_TOPIC_PREFIX             "bed/" // topic prefix
+#define UL_QOS                      1 // QoS for publishing batches
+#define UL_QUEUE_LEN                512 // max queued records
+#define UL_BATCH_RECORDS            32 // max records per batch
+#define UL_BATCH_MIN                16 // min records to publish early
+#define UL_BATCH_PERIOD             60000 // max time (ms) records are held
+#define UL_STACK_SIZE               3072 // uplink task stack size
+
+/* record types */
+#define UL_RECORD_TEMP              't' // temperature (0.01 C)
+#define UL_RECORD_OCC               'o' // occupancy (0/1)
+#define UL_RECORD_HELP              'h' // help request (1 = raised/0 = cleared)
+
+#define UL_VERSION                  1 // batch format version
+
+/* batch header (little endian) */
+struct __attribute__((packed)) ul_header {
+    uint8_t version; // UL_VERSION
+    uint8_t count; // number of records following the header
+    uint16_t dropped; // records dropped so far (saturating)
+    uint32_t boot_id; // random ID generated on boot
+    uint32_t seq; // sequence number of first record since boot
+    uint32_t sent; // time of publishing (ms since boot)
+};
+
+/* record (little endian) */
+struct __attribute__((packed)) ul_record {
+    uint32_t time; // time of record (ms since boot)
+    uint8_t type; // record type (UL_RECORD_x)
+    uint8_t reserved;
+    int16_t value; // record value
+};
+
+/*
+ * void ul_init()
+ *  Initialises the uplink and starts connecting to the broker. This requires
+ *  esp_netif to be initialised beforehand.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void ul_init();
+
+/*
+ * void ul_push(uint8_t type, int16_t value)
+ *  Queues a record for publishing. Help records cause the queue to be
+ *  flushed immediately. This never blocks, and may be called from any task
+ *  (including timer callbacks).
+ *  Inputs:
+ *   - type  : The record type (UL_RECORD_x).
+ *   - value : The record value.
+ *  Output: None.
+ */
+void ul_push(uint8_t type, int16_t value);
@@ -1,16 +1,73 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
-/* WiFi credentials - we may need to make this configurable */
-#define WIFI_SSID                   "BedTest"
-#define WIFI_PASSWORD               "12345678"
+#define WEB_MAX_CLIENTS             7 // max number of concurrent clients
+#define WEB_WS_MAX_MSG              32 // max length of client WS messages
+#define WEB_METRICS_PERIOD          10000 // metrics update period (ms)
+#define WEB_PENDING_PERIOD          250 // rate limited update check period
+    // (ms) - see web_ws_flush_pending()
+#define WEB_SCOPE_SLOW_SEND         20 // scope send duration (ms) for backoff
+#define WEB_SCOPE_MAX_DECIMATE      16 // max scope decimation factor
+#define WEB_TEMPS_CHUNK             32 // temperatures per T: fragment
+
+/*
+ * index.htm placeholder for the Chart.js script tag, which is substituted in
+ * builds embedding Chart.js (WEB_EMBED_CHARTJS), so that other builds do not
+ * spend a request (of WEB_MAX_CLIENTS) on it
+ */
+#define WEB_CHARTJS_MARKER          "<!-- WEB_EMBED_CHARTJS -->"
+#define WEB_CHARTJS_SCRIPT \
+    "<script src=\"chart.umd.min.js\"></script>"
+
+/* WebSocket subscription topics */
+enum web_topic {
+    WEB_TOPIC_TEMP = 0, // temperature ('t') - T:/t: messages
+    WEB_TOPIC_OCC, // occupancy ('o') - o: messages
+    WEB_TOPIC_HELP, // help signalling ('h') - h: messages
+    WEB_TOPIC_FORCE, // raw force ('f') - binary scope frames
+    WEB_TOPIC_METRICS, // runtime metrics ('m') - m: messages
+    WEB_NUM_TOPICS
+};
+
+#define WEB_DEFAULT_TOPICS \
+    ((1 << WEB_TOPIC_TEMP) | (1 << WEB_TOPIC_OCC) | (1 << WEB_TOPIC_HELP))
+    // topics for clients that do not subscribe explicitly
+
+#define WEB_UPDATE_MAX_LEN          16 // max length of a t:/o:/h: message
+    // including null termination
+
+/*
+ * static inline size_t web_format_update(char *buf, size_t len,
+ *                                        enum web_topic topic, float value)
+ *  Formats a temperature (t:), occupancy (o:) or help (h:) update message,
+ *  as sent by the unit and relayed by the host tools.
+ *  Inputs:
+ *   - buf   : The output buffer (null-terminated).
+ *   - len   : The output buffer's length (e.g. WEB_UPDATE_MAX_LEN).
+ *   - topic : WEB_TOPIC_TEMP, WEB_TOPIC_OCC or WEB_TOPIC_HELP.
+ *   - value : The temperature (degC), or the status for the other topics
+ *             (zero is sent as 0, anything else as 1).
+ *  Output: The length of the message (truncated to fit the buffer).
+ */
+static inline size_t web_format_update(char *buf, size_t len,
+                                       enum web_topic topic, float value) {
+    int ret = (topic == WEB_TOPIC_TEMP)
+        ? snprintf(buf, len, "t:%3.2f", value)
+        : snprintf(
+            buf, len, "%c:%c",
+            (topic == WEB_TOPIC_OCC) ? 'o' : 'h', value ? '1' : '0'
+        );
+    return ((size_t)ret < len) ? (size_t)ret : len - 1;
+}
 
 /*
  * void web_init()
- *  Initialises the web server.
+ *  Initialises the web server. This requires networking to be initialised
+ *  beforehand (see wm_init()).
  *  Inputs: None.
  *  Output: None.
  */
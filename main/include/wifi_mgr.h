@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * WiFi credentials - these are the defaults, which can be overridden by
+ * storing "ssid" and "password" strings in the WM_NVS_NAMESPACE namespace
+ */
+#define WIFI_SSID                   "BedTest"
+#define WIFI_PASSWORD               "12345678"
+
+/* static IP configuration - leave WM_STATIC_IP undefined to use DHCP */
+// #define WM_STATIC_IP                "192.168.1.50"
+#define WM_STATIC_NETMASK           "255.255.255.0"
+#define WM_STATIC_GW                "192.168.1.1"
+#define WM_STATIC_DNS               "192.168.1.1"
+
+#define WM_NVS_NAMESPACE            "wifi_mgr" // NVS namespace for cache
+#define WM_BACKOFF_MIN              250 // initial reconnection backoff (ms)
+#define WM_BACKOFF_MAX              30000 // max reconnection backoff (ms)
+#define WM_FAST_FAILS               2 // failed fast connects before rescan
+
+/* connection statistics */
+struct wm_stats {
+    bool connected; // whether an IP address is currently held
+    bool fast; // whether the last connection used the cached AP
+    uint8_t last_reason; // last disconnection reason (wifi_err_reason_t)
+    uint32_t attempts; // number of connection attempts
+    uint32_t connects; // number of successful connections (IP acquired)
+    uint32_t disconnects; // number of disconnections
+    uint32_t last_connect_ms; // duration of last connection (attempt to IP)
+    int64_t first_ip_us; // time since boot to first IP (us), 0 if none yet
+};
+
+/*
+ * void wm_init()
+ *  Initialises WiFi and starts connecting to the configured network. This
+ *  requires NVS, esp_netif and the default event loop to be initialised
+ *  beforehand. Connections use the AP (BSSID and channel) cached from the
+ *  last successful connection to skip scanning, with DHCP leases restored by
+ *  lwIP (CONFIG_LWIP_DHCP_RESTORE_LAST_IP) or a static IP (WM_STATIC_IP).
+ *  Reconnections use jittered exponential backoff.
+ *  Inputs: None.
+ *  Output: None.
+ */
+void wm_init();
+
+/*
+ * void wm_get_stats(struct wm_stats *stats)
+ *  Retrieves the WiFi connection statistics.
+ *  Inputs:
+ *   - stats : Pointer to the statistics output. This must be non-null.
+ *  Output: None.
+ */
+void wm_get_stats(struct wm_stats *stats);
@@ -0,0 +1,63 @@
+#include "bench.h"
+
+#if BENCH_ENABLE
+
+#include "safe_adc.h"
+#include "fsr.h"
+
+#include <esp_cpu.h>
+#include <esp_log.h>
+
+#include <stdio.h>
+
+#define TAG                         "bench" // for logging
+
+uint32_t bench_clock() {
+    return esp_cpu_get_cycle_count();
+}
+
+void bench_report(const char *name, uint32_t iters, uint32_t ticks) {
+    double cycles = (double)ticks / iters;
+    printf(
+        "{\"bench\":\"%s\",\"platform\":\"esp32\",\"iters\":%lu,"
+        "\"ns\":%.1f,\"cycles\":%.1f}\n",
+        name, (unsigned long)iters,
+        cycles * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, cycles
+    );
+}
+
+/*
+ * static void bench_adc_read(uint32_t iters)
+ *  Benchmarks a calibrated ADC read of the FSR channel, including the ADC
+ *  mutex acquisition.
+ */
+static void bench_adc_read(uint32_t iters) {
+    int voltage;
+    for (uint32_t i = 0; i < iters; i++)
+        adc_read(FSR_PIN_CHANNEL, &voltage, portMAX_DELAY);
+}
+
+/*
+ * static void bench_fsr_read(uint32_t iters)
+ *  Benchmarks a full FSR reading (ADC read and conversion).
+ */
+static void bench_fsr_read(uint32_t iters) {
+    for (uint32_t i = 0; i < iters; i++) fsr_read(portMAX_DELAY);
+}
+
+static const struct bench_case bench_target_cases[] = {
+    { "adc_read", bench_adc_read, 200 },
+    { "fsr_read", bench_fsr_read, 200 }
+};
+
+void bench_run() {
+    ESP_LOGI(TAG, "running benchmarks");
+    bench_run_cases(bench_portable_cases, bench_num_portable_cases);
+    bench_run_cases(
+        bench_target_cases,
+        sizeof(bench_target_cases) / sizeof(struct bench_case)
+    );
+    ESP_LOGI(TAG, "benchmarks done");
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "bench.h"
+
+#if BENCH_ENABLE || !defined(ESP_PLATFORM) // also built for the host
+
+#include "fsr.h"
+#include "thermistor.h"
+#include "tscomp.h"
+#include "pool.h"
+#include "webserver.h"
+#include "vdiv.h"
+
+#include <math.h>
+
+static volatile float bench_sink; // keeps results from being optimised out
+
+/*
+ * static int bench_voltage(uint32_t i)
+ *  Generates a test voltage sweeping the ADC's useful range.
+ *  Inputs:
+ *   - i : The iteration number.
+ *  Output: The voltage in mV.
+ */
+static int bench_voltage(uint32_t i) {
+    return 150 + (i * 37) % 3000;
+}
+
+/*
+ * static void bench_calibrate(uint32_t iters)
+ *  Reference case (BENCH_CALIBRATION) measuring the machine rather than the
+ *  code: a dependent chain of integer multiplications that the compiler
+ *  cannot vectorise or fold.
+ */
+static void bench_calibrate(uint32_t iters) {
+    uint32_t x = 1;
+    for (uint32_t i = 0; i < iters; i++) {
+        for (int j = 0; j < 16; j++) x = x * (x | 1) + 12345;
+    }
+    bench_sink = x;
+}
+
+/*
+ * static void bench_calc_resistance(uint32_t iters)
+ *  Benchmarks the voltage divider calculation.
+ */
+static void bench_calc_resistance(uint32_t iters) {
+    float acc = 0;
+    for (uint32_t i = 0; i < iters; i++)
+        acc += calc_resistance(bench_voltage(i), 10000);
+    bench_sink = acc;
+}
+
+/*
+ * static void bench_fsr_calc_<model>(uint32_t iters)
+ * static void bench_rt_calc_<model>(uint32_t iters)
+ *  Benchmark each registered sensor model's conversion kernel.
+ */
+#define BENCH_FSR_CALC(name, r_pd, max_force, curve) \
+static void bench_fsr_calc_##name(uint32_t iters) { \
+    float acc = 0; \
+    for (uint32_t i = 0; i < iters; i++) \
+        acc += fsr_calc_##name(bench_voltage(i)); \
+    bench_sink = acc; \
+}
+FSR_MODELS(BENCH_FSR_CALC)
+
+#define BENCH_RT_CALC(name, B, R0, t0, r_pd) \
+static void bench_rt_calc_##name(uint32_t iters) { \
+    float acc = 0; \
+    for (uint32_t i = 0; i < iters; i++) \
+        acc += rt_calc_##name(bench_voltage(i)); \
+    bench_sink = acc; \
+}
+RT_MODELS(BENCH_RT_CALC)
+
+/*
+ * static void bench_fsr_sample(uint32_t iters)
+ *  Benchmarks the per-sample FSR processing after the ADC read: conversion
+ *  with the bound model plus the moving average and tap detection.
+ */
+static void bench_fsr_sample(uint32_t iters) {
+    struct fsr_filter filter = { 0 };
+    int64_t stamp = 0;
+    uint32_t taps = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        int voltage = bench_voltage(i) / 4; // slow sweep
+        if (i % 50 == 0) voltage += 2000; // with periodic taps
+        taps += fsr_filter_update(&filter, FSR_CALC(voltage), stamp);
+        stamp += FSR_INTERVAL * 1000LL;
+    }
+    bench_sink = filter.avg_force + taps;
+}
+
+static struct ts_block bench_history_blocks[RT_HISTORY_SIZE / TS_BLOCK_SIZE];
+static struct ts_store bench_history;
+
+/*
+ * static void bench_history_init()
+ *  Fills the benchmark history store with a full synthetic temperature
+ *  history (slow drift with sensor noise).
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void bench_history_init() {
+    ts_init(
+        &bench_history, bench_history_blocks,
+        sizeof(bench_history_blocks) / sizeof(struct ts_block)
+    );
+    uint32_t seed = 1;
+    for (size_t i = 0; i < 2 * RT_HISTORY_LEN; i++) {
+        seed = seed * 1103515245 + 12345;
+        float noise = (float)((seed >> 16) % 11 - 5) / 100;
+        ts_append(&bench_history, 36.5f + sinf(i / 40.0f) + noise);
+    }
+}
+
+/*
+ * static void bench_history_format(uint32_t iters)
+ *  Benchmarks serialising the temperature history into T: fragments, as
+ *  sent to clients (without the network send).
+ */
+static void bench_history_format(uint32_t iters) {
+    if (!bench_history.count) bench_history_init();
+
+    static char buf[POOL_FRAME_SIZE];
+    size_t total = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        struct ts_iter it; ts_iter_init(&it, &bench_history);
+        if (bench_history.count > RT_HISTORY_LEN)
+            ts_iter_skip(&it, bench_history.count - RT_HISTORY_LEN);
+        size_t len = 2, chunk; bool first = true;
+        buf[0] = 'T'; buf[1] = ':';
+        do {
+            len += ts_format(&it, &buf[len], WEB_TEMPS_CHUNK, !first, &chunk);
+            if (chunk) first = false;
+            total += len; len = 0;
+        } while (chunk == WEB_TEMPS_CHUNK);
+    }
+    bench_sink = total;
+}
+
+/*
+ * static void bench_ws_text(uint32_t iters)
+ *  Benchmarks formatting the t:, o: and h: update messages.
+ */
+static void bench_ws_text(uint32_t iters) {
+    static char buf[POOL_FRAME_SIZE];
+    size_t total = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        total += web_format_update(
+            buf, sizeof(buf), WEB_TOPIC_TEMP, 36.5f + i % 100 / 50.f
+        );
+        total += web_format_update(buf, sizeof(buf), WEB_TOPIC_OCC, i & 1);
+        total += web_format_update(buf, sizeof(buf), WEB_TOPIC_HELP, i & 2);
+    }
+    bench_sink = total;
+}
+
+#define BENCH_FSR_CASE(name, r_pd, max_force, curve) \
+    { "fsr_calc_" #name, bench_fsr_calc_##name, 10000 },
+#define BENCH_RT_CASE(name, B, R0, t0, r_pd) \
+    { "rt_calc_" #name, bench_rt_calc_##name, 10000 },
+
+const struct bench_case bench_portable_cases[] = {
+    { BENCH_CALIBRATION, bench_calibrate, 20000 },
+    { "calc_resistance", bench_calc_resistance, 10000 },
+    FSR_MODELS(BENCH_FSR_CASE)
+    RT_MODELS(BENCH_RT_CASE)
+    { "fsr_sample", bench_fsr_sample, 10000 },
+    { "history_format", bench_history_format, 20 },
+    { "ws_text", bench_ws_text, 10000 }
+};
+const size_t bench_num_portable_cases =
+    sizeof(bench_portable_cases) / sizeof(struct bench_case);
+
+void bench_run_cases(const struct bench_case *cases, size_t num) {
+    for (size_t i = 0; i < num; i++) {
+        cases[i].run(1); // warm up (caches, lazy initialisation)
+        uint32_t best = UINT32_MAX;
+        for (size_t r = 0; r < BENCH_REPEATS; r++) {
+            uint32_t start = bench_clock();
+            cases[i].run(cases[i].iters);
+            uint32_t ticks = bench_clock() - start; // wraparound-safe
+            if (ticks < best) best = ticks;
+        }
+        bench_report(cases[i].name, cases[i].iters, best);
+    }
+}
+
+#endif
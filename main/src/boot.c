@@ -0,0 +1,171 @@
+#include "boot.h"
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+
+#include <stdio.h>
+
+#define TAG                                 "boot"
+
+/* stage timing */
+struct boot_time {
+    int64_t start; // stage start timestamp (us since boot)
+    int64_t end; // stage end timestamp (us since boot)
+    int core; // core that ran the stage
+};
+
+static const struct boot_stage *boot_stages;
+static size_t boot_num_stages;
+static struct boot_time boot_times[BOOT_MAX_STAGES];
+static int64_t boot_marks[BOOT_NUM_MARKS]; // 0 until reached
+
+static const char *boot_mark_names[BOOT_NUM_MARKS] = {
+    "first_force", "first_temp", "httpd", "ip"
+};
+
+static uint32_t boot_claimed; // bitmask of started stages
+static portMUX_TYPE boot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static EventGroupHandle_t boot_done; // bits of finished stages
+static StaticEventGroup_t boot_done_buf;
+
+/*
+ * static void boot_work()
+ *  Runs boot stages whose dependencies are satisfied until all stages have
+ *  been started.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void boot_work() {
+    uint32_t all = (1UL << boot_num_stages) - 1;
+
+    while (true) {
+        uint32_t done = xEventGroupGetBits(boot_done);
+
+        /* claim next ready stage */
+        int next = -1;
+        taskENTER_CRITICAL(&boot_lock);
+        for (size_t i = 0; i < boot_num_stages; i++) {
+            uint32_t deps = boot_stages[i].deps;
+            if (!(boot_claimed & (1UL << i)) && (done & deps) == deps) {
+                boot_claimed |= 1UL << i;
+                next = i;
+                break;
+            }
+        }
+        bool finished = boot_claimed == all;
+        taskEXIT_CRITICAL(&boot_lock);
+
+        if (next >= 0) {
+            struct boot_time *time = &boot_times[next];
+            time->core = xPortGetCoreID();
+            time->start = esp_timer_get_time();
+            boot_stages[next].init();
+            time->end = esp_timer_get_time();
+            ESP_LOGI(
+                TAG, "stage %s finished in %lld us (core %d)",
+                boot_stages[next].name, time->end - time->start, time->core
+            );
+            xEventGroupSetBits(boot_done, 1UL << next);
+        } else if (finished) return;
+        else { // wait for another stage to finish
+            xEventGroupWaitBits(
+                boot_done, all & ~done, pdFALSE, pdFALSE, portMAX_DELAY
+            );
+        }
+    }
+}
+
+/*
+ * static void boot_worker_task(void *parameter)
+ *  Task function for helper boot workers.
+ *  Inputs:
+ *   - parameter: Parameter from xTaskCreate - ignored.
+ *  Output: None.
+ */
+static void boot_worker_task(void *parameter) {
+    (void) parameter;
+    boot_work();
+    vTaskDelete(NULL);
+}
+
+void boot_run(const struct boot_stage *stages, size_t num_stages) {
+    assert(num_stages <= BOOT_MAX_STAGES);
+    boot_stages = stages; boot_num_stages = num_stages;
+    boot_done = xEventGroupCreateStatic(&boot_done_buf);
+
+    /*
+     * NOTE: helper workers are only needed during boot, so they are created
+     * dynamically for their stacks to be returned to the heap afterwards.
+     */
+    for (size_t i = 1; i < BOOT_WORKERS; i++) {
+        xTaskCreate(
+            boot_worker_task, "boot", BOOT_WORKER_STACK, NULL,
+            uxTaskPriorityGet(NULL), NULL
+        );
+    }
+    boot_work();
+
+    xEventGroupWaitBits(
+        boot_done, (1UL << num_stages) - 1, pdFALSE, pdTRUE, portMAX_DELAY
+    ); // wait for stages running on other workers
+    ESP_LOGI(TAG, "boot completed in %lld us", esp_timer_get_time());
+}
+
+void boot_mark(enum boot_mark mark) {
+    if (boot_marks[mark]) return; // already reached
+
+    int64_t now = esp_timer_get_time();
+    bool reached = false;
+    taskENTER_CRITICAL(&boot_lock);
+    if (!boot_marks[mark]) {
+        boot_marks[mark] = now;
+        reached = true;
+    }
+    taskEXIT_CRITICAL(&boot_lock);
+
+    if (reached)
+        ESP_LOGI(TAG, "%s reached at %lld us", boot_mark_names[mark], now);
+}
+
+int64_t boot_get_mark(enum boot_mark mark) {
+    taskENTER_CRITICAL(&boot_lock);
+    int64_t time = boot_marks[mark];
+    taskEXIT_CRITICAL(&boot_lock);
+    return time;
+}
+
+size_t boot_report(char *buf, size_t len) {
+    size_t pos = 0;
+#define BOOT_APPEND(...) \
+    pos += snprintf(&buf[(pos < len) ? pos : len], \
+                    (pos < len) ? len - pos : 0, __VA_ARGS__)
+
+    BOOT_APPEND("{\"reset_reason\":%d,\"stages\":[", esp_reset_reason());
+    for (size_t i = 0; i < boot_num_stages; i++) {
+        BOOT_APPEND(
+            "%s{\"name\":\"%s\",\"start\":%lld,\"end\":%lld,\"core\":%d}",
+            (i) ? "," : "", boot_stages[i].name,
+            boot_times[i].start, boot_times[i].end, boot_times[i].core
+        );
+    }
+    BOOT_APPEND("],\"marks\":{");
+    for (size_t i = 0; i < BOOT_NUM_MARKS; i++) {
+        BOOT_APPEND(
+            "%s\"%s\":%lld", (i) ? "," : "", boot_mark_names[i],
+            boot_marks[i]
+        );
+    }
+    int64_t httpd = boot_marks[BOOT_MARK_HTTPD], ip = boot_marks[BOOT_MARK_IP];
+    int64_t serving = (httpd && ip) ? ((httpd > ip) ? httpd : ip) : 0;
+        // serving = both listening and reachable
+    BOOT_APPEND(",\"serving\":%lld}}", serving);
+
+#undef BOOT_APPEND
+    return pos;
+}
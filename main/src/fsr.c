@@ -1,47 +1,22 @@
 #include "fsr.h"
-#include "vdiv.h" // voltage divider support
 #include "safe_adc.h"
 #include "priorities.h"
 #include "sense_events.h"
+#include "boot.h"
+#include "uplink.h"
+#include "pool.h"
+#include "state.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define TAG                         "fsr" // for logging
 
-static const float fsr_curve_R[] = { FSR_RESISTANCES };
-static const float fsr_curve_F[] = { FSR_FORCES };
-
-/*
- * static float fsr_calc(int voltage)
- *  Calculates the applied force given the FSR's measurement.
- *  Inputs:
- *   - voltage : The measured voltage across the FSR's pulldown resistor in mV.
- *  Output: The applied force in grams.
- */
-static float fsr_calc(int voltage) {
-    float R = calc_resistance(voltage, FSR_R_PD); // calculate resistance
-
-    if (R > fsr_curve_R[0]) return 0; // measured resistance > max
-
-    size_t seg = 0; // curve segment index - [seg] to [seg + 1]
-    for (; seg < sizeof(fsr_curve_R) / sizeof(float) - 1; seg++) {
-        if (R <= fsr_curve_R[seg] && R >= fsr_curve_R[seg + 1]) break;
-    }
-
-    /* find segment's slope and intercept */
-    float slope = 
-            (fsr_curve_F[seg + 1] - fsr_curve_F[seg])
-        /   (fsr_curve_R[seg + 1] - fsr_curve_R[seg]);
-    float intercept = fsr_curve_F[seg] - fsr_curve_R[seg] * slope;
-
-    float F = slope * R + intercept; // i.e. linearly map R to F
-    if (F > FSR_MAX_FORCE) F = FSR_MAX_FORCE; // clamp force
-
-    return F;
-}
-
 static StaticTask_t fsr_tap_task_buf;
 #define STACK_SIZE                          2048
 static StackType_t fsr_tap_task_stack[STACK_SIZE];
@@ -78,7 +53,9 @@ static void fsr_tap_task(void *parameter) {
                         TAG, "%d taps registered in %d ms - triggering signal",
                         FSR_NUM_TAPS, pdTICKS_TO_MS(stamp - first)
                     );
+                    st_set_help(true);
                     xEventGroupSetBits(se_events, SE_HELP);
+                    ul_push(UL_RECORD_HELP, 1);
                     count = 0; // might be a good iea to do this anyway
                 }
             }
@@ -86,42 +63,145 @@ static void fsr_tap_task(void *parameter) {
     }
 }
 
-static float fsr_avg_force; // average recorded force
-static TickType_t fsr_last_tap = 0; // tickstamp of last tap - for debouncing
-
-/* task support structures */
-static StaticTask_t fsr_task_buf; // TCB
-static StackType_t fsr_task_stack[STACK_SIZE];
+/*
+ * Scope ring buffer. The sensing task is the only producer and the scope
+ * consumer (the webserver) the only consumer, so free-running head/tail
+ * indices are sufficient for synchronisation.
+ */
+static struct fsr_scope_sample fsr_scope_ring[FSR_SCOPE_RING_LEN];
+static atomic_uint_least32_t fsr_scope_head; // write index (producer)
+static atomic_uint_least32_t fsr_scope_tail; // read index (consumer)
+static atomic_bool fsr_scope_enabled;
+static atomic_uint_least32_t fsr_scope_dropped; // samples dropped when full
 
 /*
- * static void fsr_task(void *parameter)
- *  Task function for the FSR sensing task.
+ * static void fsr_scope_push(float force, int voltage)
+ *  Pushes a raw sample into the scope ring buffer (if enabled), signalling
+ *  SE_SCOPE whenever a batch is ready. Never blocks.
  *  Inputs:
- *   - parameter: Parameter from xTaskCreateStatic - ignored.
+ *   - force   : The force measurement in grams (NAN if reading failed).
+ *   - voltage : The ADC voltage in millivolts.
  *  Output: None.
  */
-static void fsr_task(void *parameter) {
-    while (true) {
-        float force = fsr_read(portMAX_DELAY);
-        fsr_avg_force = // exponential moving average
-            FSR_AVG_FACTOR * force + (1 - FSR_AVG_FACTOR) * fsr_avg_force;
+static void fsr_scope_push(float force, int voltage) {
+    if (!atomic_load_explicit(&fsr_scope_enabled, memory_order_relaxed))
+        return;
 
-        if (force - fsr_avg_force >= FSR_TAP_THRESHOLD) {
-            TickType_t now = xTaskGetTickCount();
-            if (now - fsr_last_tap >= pdMS_TO_TICKS(FSR_TAP_DEBOUNCE)) {
-                ESP_LOGI(TAG, "tap detected");
-                fsr_last_tap = now;
-                xQueueSend(fsr_tap_queue, &now, 0); // so we don't get stuck
-            }
-        }
+    uint32_t head =
+        atomic_load_explicit(&fsr_scope_head, memory_order_relaxed);
+    uint32_t tail =
+        atomic_load_explicit(&fsr_scope_tail, memory_order_acquire);
+    if (head - tail >= FSR_SCOPE_RING_LEN) { // full - drop new sample
+        atomic_fetch_add_explicit(
+            &fsr_scope_dropped, 1, memory_order_relaxed
+        );
+        return;
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(FSR_INTERVAL));
+    struct fsr_scope_sample *sample =
+        &fsr_scope_ring[head % FSR_SCOPE_RING_LEN];
+    sample->force = (isnan(force)) ? UINT16_MAX : (uint16_t)force;
+    sample->voltage = (uint16_t)voltage;
+    atomic_store_explicit(&fsr_scope_head, head + 1, memory_order_release);
+
+    if ((head + 1 - tail) % FSR_SCOPE_BATCH == 0)
+        xEventGroupSetBits(se_events, SE_SCOPE); // batch ready
+}
+
+void fsr_scope_enable(bool enable) {
+    if (enable) { // discard stale samples
+        atomic_store_explicit(
+            &fsr_scope_tail,
+            atomic_load_explicit(&fsr_scope_head, memory_order_acquire),
+            memory_order_release
+        );
     }
+    atomic_store_explicit(&fsr_scope_enabled, enable, memory_order_relaxed);
+}
+
+size_t fsr_scope_read(struct fsr_scope_sample *buf, size_t len,
+                      uint32_t *seq, uint32_t *dropped) {
+    uint32_t tail =
+        atomic_load_explicit(&fsr_scope_tail, memory_order_relaxed);
+    uint32_t head =
+        atomic_load_explicit(&fsr_scope_head, memory_order_acquire);
+    *seq = tail;
+    *dropped = atomic_load_explicit(&fsr_scope_dropped, memory_order_relaxed);
+
+    size_t count = head - tail;
+    if (count < FSR_SCOPE_BATCH) return 0; // no full batch yet
+    if (count > len) count = len;
+    for (size_t i = 0; i < count; i++)
+        buf[i] = fsr_scope_ring[(tail + i) % FSR_SCOPE_RING_LEN];
+
+    atomic_store_explicit(
+        &fsr_scope_tail, tail + count, memory_order_release
+    );
+    return count;
+}
+
+static struct fsr_timing fsr_timing; // sampling timing statistics
+static portMUX_TYPE fsr_timing_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * static void fsr_timing_update(int64_t interval)
+ *  Updates the sampling timing statistics with a new sample.
+ *  Inputs:
+ *   - interval : Time since the previous sample (us), or 0 if there is none.
+ *  Output: None.
+ */
+static void fsr_timing_update(int64_t interval) {
+    int64_t jitter = (interval) ? llabs(interval - FSR_INTERVAL * 1000LL) : 0;
+
+    taskENTER_CRITICAL(&fsr_timing_lock);
+    fsr_timing.samples++;
+    if (interval > 2 * FSR_INTERVAL * 1000LL) fsr_timing.late++;
+    if (jitter > fsr_timing.max_jitter_us) fsr_timing.max_jitter_us = jitter;
+    taskEXIT_CRITICAL(&fsr_timing_lock);
+}
+
+void fsr_get_timing(struct fsr_timing *timing, bool reset) {
+    taskENTER_CRITICAL(&fsr_timing_lock);
+    if (timing) *timing = fsr_timing;
+    if (reset) memset(&fsr_timing, 0, sizeof(struct fsr_timing));
+    taskEXIT_CRITICAL(&fsr_timing_lock);
 }
 
+static struct fsr_filter fsr_filter; // moving average and tap detection
+static bool fsr_occupancy; // last published occupancy (timer task only)
+
 static StaticTimer_t fsr_occ_timer_buf; // buffer for occupancy check timer
+static bool fsr_occ_published = false; // set once occupancy is initialised
 
-bool fsr_occupancy;
+/*
+ * static void fsr_occ_check(void *param, uint32_t arg)
+ *  Checks bed occupancy, publishing the initial occupancy on the first call
+ *  and any change from then on. This only runs in the timer task (see
+ *  xTimerPendFunctionCall()), so that the occupancy has a single writer.
+ *  Inputs:
+ *   - param : Ignored.
+ *   - arg   : Ignored.
+ *  Output: None.
+ */
+static void fsr_occ_check(void *param, uint32_t arg) {
+    (void) param; (void) arg;
+    float avg_force = fsr_filter.avg_force;
+    bool occupancy = avg_force >= FSR_OCC_THRESHOLD;
+    ESP_LOGI(
+        TAG, "average force: %.2f g (occupancy: %d)",
+        avg_force, occupancy ? 1 : 0
+    );
+    if (!fsr_occ_published) {
+        fsr_occ_published = true;
+        fsr_occupancy = occupancy;
+        st_set_occupancy(occupancy);
+    } else if (occupancy != fsr_occupancy) {
+        fsr_occupancy = occupancy;
+        st_set_occupancy(occupancy);
+        xEventGroupSetBits(se_events, SE_OCC_UPDATE);
+        ul_push(UL_RECORD_OCC, occupancy);
+    }
+}
 
 /*
  * static void fsr_occ_callback(TimerHandle_t timer)
@@ -132,21 +212,59 @@ bool fsr_occupancy;
  */
 static void fsr_occ_callback(TimerHandle_t timer) {
     (void) timer;
-    bool occupancy = fsr_avg_force >= FSR_OCC_THRESHOLD;
-    ESP_LOGI(
-        TAG, "average force: %.2f g (occupancy: %d)",
-        fsr_avg_force, occupancy ? 1 : 0
-    );
-    if (occupancy != fsr_occupancy) {
-        fsr_occupancy = occupancy;
-        xEventGroupSetBits(se_events, SE_OCC_UPDATE);
+    fsr_occ_check(NULL, 0);
+}
+
+/* task support structures */
+static StaticTask_t fsr_task_buf; // TCB
+static StackType_t fsr_task_stack[STACK_SIZE];
+
+/*
+ * static void fsr_task(void *parameter)
+ *  Task function for the FSR sensing task.
+ *  Inputs:
+ *   - parameter: Parameter from xTaskCreateStatic - ignored.
+ *  Output: None.
+ */
+static void fsr_task(void *parameter) {
+    TickType_t wake = xTaskGetTickCount();
+    bool first = true; // set until the first sample is taken
+    int64_t last = 0; // timestamp of previous sample
+    pool_guard_begin(); // no heap allocations expected from here on
+    while (true) {
+        int64_t stamp = esp_timer_get_time();
+        fsr_timing_update((last) ? stamp - last : 0);
+        last = stamp;
+
+        int voltage; float force = NAN;
+        if (adc_read(FSR_PIN_CHANNEL, &voltage, portMAX_DELAY) == ESP_OK)
+            force = FSR_CALC(voltage);
+        else voltage = 0;
+        fsr_scope_push(force, voltage);
+
+        bool tap = fsr_filter_update(&fsr_filter, force, stamp);
+        if (!isnan(force)) boot_mark(BOOT_MARK_FIRST_FORCE);
+        if (first) {
+            first = false;
+            xTimerPendFunctionCall(fsr_occ_check, NULL, 0, 0);
+                // initialise occupancy - or at the first periodic check if
+                // the timer queue is full
+        }
+        if (tap) {
+            TickType_t now = xTaskGetTickCount();
+            ESP_LOGI(TAG, "tap detected");
+            xQueueSend(fsr_tap_queue, &now, 0); // so we don't get stuck
+        }
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(FSR_INTERVAL));
+            // fixed sampling rate regardless of processing time
     }
 }
 
 void fsr_init() {
     adc_init_channel(FSR_PIN_CHANNEL);
-    fsr_avg_force = fsr_read(portMAX_DELAY); // initialise average force
-    fsr_occupancy = fsr_avg_force >= FSR_OCC_THRESHOLD; // and also occupancy
+        // NOTE: average force is initialised by the sensing task so that we
+        // don't block here
 
     fsr_tap_queue = xQueueCreateStatic(
         FSR_TAP_QUEUE_LEN, sizeof(TickType_t),
@@ -173,5 +291,5 @@ void fsr_init() {
 float fsr_read(TickType_t max_wait) {
     int voltage;
     if (adc_read(FSR_PIN_CHANNEL, &voltage, max_wait) != ESP_OK) return NAN;
-    return fsr_calc(voltage);
+    return FSR_CALC(voltage);
 }
\ No newline at end of file
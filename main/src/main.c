@@ -1,26 +1,87 @@
 #include <stdio.h>
 
 #include <esp_log.h>
+#include <esp_event.h>
+#include <esp_netif.h>
+#include <nvs_flash.h>
 
+#include "boot.h"
 #include "sense_events.h"
 #include "safe_adc.h"
 #include "fsr.h"
 #include "thermistor.h"
+#include "wifi_mgr.h"
 #include "webserver.h"
+#include "uplink.h"
+#include "pool.h"
+#include "ota.h"
+#include "bench.h"
+#include "trace.h"
 
 #define TAG                 "main" // log tag
 
+/*
+ * static void nvs_init()
+ *  Initialises NVS, erasing it if it is full or outdated.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void nvs_init() {
+    esp_err_t ret = nvs_flash_init();
+    if (
+            ret == ESP_ERR_NVS_NO_FREE_PAGES
+        ||  ret == ESP_ERR_NVS_NEW_VERSION_FOUND
+    ) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+}
+
+/*
+ * static void netif_init()
+ *  Initialises the network interface layer and the default event loop.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void netif_init() {
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+}
+
+/* boot stages - sensing starts as soon as the ADC is up, regardless of WiFi */
+enum {
+    STAGE_EVENTS = 0, STAGE_NVS, STAGE_ADC, STAGE_NETIF,
+    STAGE_FSR, STAGE_RT, STAGE_WIFI, STAGE_WEB, STAGE_UPLINK
+};
+#define DEP(stage)          (1UL << (stage))
+static const struct boot_stage stages[] = {
+    [STAGE_EVENTS] = { "events", se_init, 0 },
+    [STAGE_NVS] = { "nvs", nvs_init, 0 },
+    [STAGE_ADC] = { "adc", adc_init, 0 },
+    [STAGE_NETIF] = { "netif", netif_init, 0 },
+    [STAGE_FSR] = { "fsr", fsr_init, DEP(STAGE_EVENTS) | DEP(STAGE_ADC) },
+    [STAGE_RT] = { "rt", rt_init, DEP(STAGE_EVENTS) | DEP(STAGE_ADC) },
+    [STAGE_WIFI] = { "wifi", wm_init, DEP(STAGE_NVS) | DEP(STAGE_NETIF) },
+    [STAGE_WEB] = {
+        "web", web_init,
+        DEP(STAGE_EVENTS) | DEP(STAGE_NETIF) | DEP(STAGE_FSR) | DEP(STAGE_RT)
+    }, // httpd only needs the TCP/IP stack, so it need not wait for WiFi
+    [STAGE_UPLINK] = { "uplink", ul_init, DEP(STAGE_NETIF) }
+        // the MQTT client connects by itself once WiFi is up
+};
+
 void app_main(void)
 {
-    ESP_LOGI(TAG, "Hello, World!"); // TODO
-
-    se_init();
-    adc_init();
-    fsr_init();
-    rt_init();
-    web_init();
+    trace_init(); // first, so that boot can be traced too
+    boot_run(stages, sizeof(stages) / sizeof(struct boot_stage));
+    pool_guard_arm(); // steady state from here on
+    ota_self_test(); // confirm (or roll back) freshly updated image
+#if BENCH_ENABLE
+    bench_run();
+#endif
 
     while (true) {
         vTaskDelay(1); // so we can keep watchdog happy
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,367 @@
+#include "ota.h"
+#include "boot.h"
+
+#include <esp_log.h>
+#include <esp_check.h>
+#include <esp_ota_ops.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include <esp32/rom/miniz.h> // tinfl in ROM
+
+#include <mbedtls/sha256.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG                                 "ota"
+
+/* gzip stream parsing state */
+enum ota_gz_state {
+    OTA_GZ_HEADER = 0, // fixed 10 byte header
+    OTA_GZ_EXTRA_LEN, // FEXTRA length
+    OTA_GZ_SKIP, // FEXTRA data or FHCRC
+    OTA_GZ_NAME, // null-terminated FNAME
+    OTA_GZ_COMMENT, // null-terminated FCOMMENT
+    OTA_GZ_DEFLATE, // compressed data
+    OTA_GZ_DONE // trailer (ignored - the image hash is checked instead)
+};
+
+/* gzip header flags */
+#define OTA_GZ_FHCRC                        (1 << 1)
+#define OTA_GZ_FEXTRA                       (1 << 2)
+#define OTA_GZ_FNAME                        (1 << 3)
+#define OTA_GZ_FCOMMENT                     (1 << 4)
+
+static bool ota_active = false;
+static esp_ota_handle_t ota_handle;
+static const esp_partition_t *ota_partition;
+static mbedtls_sha256_context ota_sha;
+static uint8_t ota_sha_expected[OTA_SHA256_LEN];
+static int64_t ota_start; // update start timestamp (us)
+static struct ota_report ota_stats;
+
+static bool ota_gzip; // set if image is gzip compressed
+static enum ota_gz_state ota_gz_state;
+static uint8_t ota_gz_flags; // header flags yet to be handled
+static size_t ota_gz_pos; // position in current header field
+static size_t ota_gz_left; // bytes left to skip
+static tinfl_decompressor *ota_inflator = NULL;
+static uint8_t *ota_dict = NULL; // circular output buffer (dictionary)
+static size_t ota_dict_pos; // output position in dictionary
+
+/*
+ * static esp_err_t ota_flash(const uint8_t *data, size_t len)
+ *  Writes (uncompressed) image data to flash and hashes it.
+ *  Inputs:
+ *   - data : The image data.
+ *   - len  : The image data's length.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t ota_flash(const uint8_t *data, size_t len) {
+    ESP_RETURN_ON_ERROR(
+        esp_ota_write(ota_handle, data, len), TAG, "cannot write image"
+    );
+    mbedtls_sha256_update(&ota_sha, data, len);
+    ota_stats.written += len;
+    return ESP_OK;
+}
+
+/*
+ * static void ota_gz_advance()
+ *  Moves on to the next gzip header field (or the compressed data) according
+ *  to the header flags.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void ota_gz_advance() {
+    ota_gz_pos = 0;
+    if (ota_gz_flags & OTA_GZ_FEXTRA) {
+        ota_gz_flags &= ~OTA_GZ_FEXTRA;
+        ota_gz_state = OTA_GZ_EXTRA_LEN; ota_gz_left = 0;
+    } else if (ota_gz_flags & OTA_GZ_FNAME) {
+        ota_gz_flags &= ~OTA_GZ_FNAME;
+        ota_gz_state = OTA_GZ_NAME;
+    } else if (ota_gz_flags & OTA_GZ_FCOMMENT) {
+        ota_gz_flags &= ~OTA_GZ_FCOMMENT;
+        ota_gz_state = OTA_GZ_COMMENT;
+    } else if (ota_gz_flags & OTA_GZ_FHCRC) {
+        ota_gz_flags &= ~OTA_GZ_FHCRC;
+        ota_gz_state = OTA_GZ_SKIP; ota_gz_left = 2;
+    } else ota_gz_state = OTA_GZ_DEFLATE;
+}
+
+/*
+ * static esp_err_t ota_gz_header(uint8_t byte)
+ *  Parses the next byte of the gzip header.
+ *  Inputs:
+ *   - byte : The header byte.
+ *  Output: ESP_OK on success, or ESP_ERR_INVALID_ARG if the header is invalid.
+ */
+static esp_err_t ota_gz_header(uint8_t byte) {
+    static const uint8_t magic[] = { 0x1F, 0x8B, 8 }; // ID1, ID2, CM (deflate)
+
+    switch (ota_gz_state) {
+        case OTA_GZ_HEADER:
+            if (ota_gz_pos < sizeof(magic)) {
+                ESP_RETURN_ON_FALSE(
+                    byte == magic[ota_gz_pos], ESP_ERR_INVALID_ARG, TAG,
+                    "invalid gzip header"
+                );
+            } else if (ota_gz_pos == 3) ota_gz_flags = byte; // FLG
+            if (++ota_gz_pos == 10) ota_gz_advance(); // MTIME, XFL, OS skipped
+            break;
+        case OTA_GZ_EXTRA_LEN:
+            ota_gz_left |= byte << (8 * ota_gz_pos);
+            if (++ota_gz_pos == 2) {
+                ota_gz_state = OTA_GZ_SKIP;
+                if (!ota_gz_left) ota_gz_advance();
+            }
+            break;
+        case OTA_GZ_SKIP:
+            if (!--ota_gz_left) ota_gz_advance();
+            break;
+        case OTA_GZ_NAME:
+        case OTA_GZ_COMMENT:
+            if (!byte) ota_gz_advance();
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+/*
+ * static esp_err_t ota_inflate(const uint8_t *data, size_t len)
+ *  Decompresses a chunk of deflate data and writes the output to flash.
+ *  Inputs:
+ *   - data : The compressed data.
+ *   - len  : The compressed data's length.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t ota_inflate(const uint8_t *data, size_t len) {
+    while (true) {
+        size_t in = len, out = TINFL_LZ_DICT_SIZE - ota_dict_pos;
+        tinfl_status status = tinfl_decompress(
+            ota_inflator, data, &in, ota_dict, &ota_dict[ota_dict_pos], &out,
+            TINFL_FLAG_HAS_MORE_INPUT
+        );
+        data += in; len -= in;
+
+        if (out) {
+            ESP_RETURN_ON_ERROR(
+                ota_flash(&ota_dict[ota_dict_pos], out), TAG,
+                "cannot write decompressed data"
+            );
+            ota_dict_pos = (ota_dict_pos + out) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            ota_gz_state = OTA_GZ_DONE;
+            return ESP_OK;
+        }
+        ESP_RETURN_ON_FALSE(
+            status >= 0, ESP_ERR_INVALID_RESPONSE, TAG,
+            "invalid compressed data (%d)", status
+        );
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT) return ESP_OK;
+        // otherwise there is more output to be flushed
+    }
+}
+
+/*
+ * static void ota_cleanup()
+ *  Releases the decompression buffers.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void ota_cleanup() {
+    free(ota_inflator); ota_inflator = NULL;
+    free(ota_dict); ota_dict = NULL;
+    mbedtls_sha256_free(&ota_sha);
+    ota_active = false;
+}
+
+esp_err_t ota_check_token(const char *token) {
+    /*
+     * NOTE: tokens are compared zero-padded to full length, so that the time
+     * taken does not depend on where (or whether) they differ.
+     */
+    char expected[OTA_TOKEN_MAX_LEN + 1] = { 0 };
+    char given[OTA_TOKEN_MAX_LEN + 1] = { 0 };
+    size_t len = sizeof(expected);
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_get_str(nvs, "token", expected, &len);
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK || len - 1 < OTA_TOKEN_MIN_LEN) {
+        ESP_LOGW(TAG, "no update token provisioned - updates disabled");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t given_len = strnlen(token, OTA_TOKEN_MAX_LEN + 1);
+    if (given_len <= OTA_TOKEN_MAX_LEN) memcpy(given, token, given_len);
+    uint8_t diff = (given_len != len - 1);
+    for (size_t i = 0; i < OTA_TOKEN_MAX_LEN; i++)
+        diff |= given[i] ^ expected[i];
+    return (diff) ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t ota_begin(bool gzip, const uint8_t *sha256) {
+    ESP_RETURN_ON_FALSE(
+        !ota_active, ESP_ERR_INVALID_STATE, TAG, "update already in progress"
+    );
+
+    ota_partition = esp_ota_get_next_update_partition(NULL);
+    ESP_RETURN_ON_FALSE(
+        ota_partition, ESP_ERR_NOT_FOUND, TAG, "no OTA partition to update"
+    );
+
+    /*
+     * NOTE: the decompression buffers (~43 KB) are only needed during updates,
+     * so they are taken from the heap rather than reserved statically.
+     */
+    ota_gzip = gzip;
+    if (gzip) {
+        ota_inflator = malloc(sizeof(tinfl_decompressor));
+        ota_dict = malloc(TINFL_LZ_DICT_SIZE);
+        if (!ota_inflator || !ota_dict) {
+            free(ota_inflator); ota_inflator = NULL;
+            free(ota_dict); ota_dict = NULL;
+            ESP_LOGE(TAG, "cannot allocate decompression buffers");
+            return ESP_ERR_NO_MEM;
+        }
+        tinfl_init(ota_inflator);
+        ota_dict_pos = 0;
+        ota_gz_state = OTA_GZ_HEADER; ota_gz_pos = 0;
+    }
+
+    esp_err_t ret = esp_ota_begin(
+        ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle
+    );
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "cannot begin update (%s)", esp_err_to_name(ret));
+        free(ota_inflator); ota_inflator = NULL;
+        free(ota_dict); ota_dict = NULL;
+        return ret;
+    }
+
+    mbedtls_sha256_init(&ota_sha);
+    mbedtls_sha256_starts(&ota_sha, 0);
+    memcpy(ota_sha_expected, sha256, OTA_SHA256_LEN);
+    memset(&ota_stats, 0, sizeof(struct ota_report));
+    fsr_get_timing(&ota_stats.baseline, true);
+    ota_start = esp_timer_get_time();
+    ota_active = true;
+
+    ESP_LOGI(
+        TAG, "updating partition %s (%s image)",
+        ota_partition->label, (gzip) ? "gzip" : "raw"
+    );
+    return ESP_OK;
+}
+
+esp_err_t ota_write(const void *data, size_t len) {
+    ESP_RETURN_ON_FALSE(
+        ota_active, ESP_ERR_INVALID_STATE, TAG, "no update in progress"
+    );
+    ota_stats.received += len;
+    if (!ota_gzip) return ota_flash(data, len);
+
+    const uint8_t *p = (const uint8_t *)data;
+    while (len && ota_gz_state < OTA_GZ_DEFLATE) {
+        ESP_RETURN_ON_ERROR(ota_gz_header(*p), TAG, "invalid image");
+        p++; len--;
+    }
+    if (len && ota_gz_state == OTA_GZ_DEFLATE)
+        return ota_inflate(p, len);
+    return ESP_OK; // anything after the compressed data is the trailer
+}
+
+esp_err_t ota_end(struct ota_report *report) {
+    ESP_RETURN_ON_FALSE(
+        ota_active, ESP_ERR_INVALID_STATE, TAG, "no update in progress"
+    );
+
+    esp_err_t ret = ESP_OK;
+    uint8_t sha256[OTA_SHA256_LEN];
+    mbedtls_sha256_finish(&ota_sha, sha256);
+    if (ota_gzip && ota_gz_state != OTA_GZ_DONE) {
+        ESP_LOGE(TAG, "compressed image is truncated");
+        ret = ESP_ERR_INVALID_SIZE;
+    } else if (memcmp(sha256, ota_sha_expected, OTA_SHA256_LEN)) {
+        ESP_LOGE(TAG, "image hash mismatch");
+        ret = ESP_ERR_INVALID_CRC;
+    }
+    if (ret != ESP_OK) {
+        esp_ota_abort(ota_handle);
+        ota_cleanup();
+        return ret;
+    }
+
+    ret = esp_ota_end(ota_handle); // also validates the image
+    if (ret == ESP_OK) ret = esp_ota_set_boot_partition(ota_partition);
+    ota_stats.duration_ms = (esp_timer_get_time() - ota_start) / 1000;
+    fsr_get_timing(&ota_stats.during, true);
+    ota_cleanup();
+    ESP_RETURN_ON_ERROR(ret, TAG, "cannot finish update");
+
+    ESP_LOGI(
+        TAG, "wrote %lu bytes (%lu received) in %lu ms, max FSR jitter %lu us "
+        "(%lu us before), %lu late samples",
+        (unsigned long)ota_stats.written, (unsigned long)ota_stats.received,
+        (unsigned long)ota_stats.duration_ms,
+        (unsigned long)ota_stats.during.max_jitter_us,
+        (unsigned long)ota_stats.baseline.max_jitter_us,
+        (unsigned long)ota_stats.during.late
+    );
+    if (report) *report = ota_stats;
+    return ESP_OK;
+}
+
+void ota_abort() {
+    if (!ota_active) return;
+    esp_ota_abort(ota_handle);
+    ota_cleanup();
+    ESP_LOGW(TAG, "update aborted");
+}
+
+/* milestones required by the self-test (local health only) */
+static const enum boot_mark ota_selftest_marks[] = {
+    BOOT_MARK_FIRST_FORCE, BOOT_MARK_FIRST_TEMP, BOOT_MARK_HTTPD
+};
+#define OTA_SELFTEST_MARKS \
+    (sizeof(ota_selftest_marks) / sizeof(enum boot_mark))
+
+void ota_self_test() {
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (
+            esp_ota_get_state_partition(running, &state) != ESP_OK
+        ||  state != ESP_OTA_IMG_PENDING_VERIFY
+    ) return; // not a new image
+
+    ESP_LOGI(TAG, "running self-test on new image");
+    while (esp_timer_get_time() < OTA_SELFTEST_TIMEOUT * 1000LL) {
+        bool passed = true;
+        for (size_t i = 0; i < OTA_SELFTEST_MARKS; i++) {
+            if (!boot_get_mark(ota_selftest_marks[i])) passed = false;
+        }
+        if (passed) {
+            ESP_LOGI(
+                TAG, "self-test passed - image confirmed%s",
+                (boot_get_mark(BOOT_MARK_IP)) ? "" : " (no IP address yet)"
+            );
+            ESP_ERROR_CHECK(esp_ota_mark_app_valid_cancel_rollback());
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    ESP_LOGE(TAG, "self-test failed - rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot(); // does not return
+}
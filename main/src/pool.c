@@ -0,0 +1,223 @@
+#include "pool.h"
+
+#include <esp_attr.h>
+#include <esp_log.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG                                 "pool"
+
+/* pool storage - reserved statically so that it never touches the heap */
+static uint8_t pool_frame_stor[POOL_FRAME_COUNT][POOL_FRAME_SIZE]
+    __attribute__((aligned(4)));
+static uint8_t pool_chunk_stor[POOL_CHUNK_COUNT][POOL_CHUNK_SIZE]
+    __attribute__((aligned(4)));
+
+_Static_assert(
+    POOL_FRAME_COUNT <= 32 && POOL_CHUNK_COUNT <= 32,
+    "pools are tracked using 32-bit bitmasks"
+);
+
+/* buffer pool */
+struct pool {
+    uint8_t *stor; // pointer to storage
+    size_t size; // buffer size
+    uint8_t count; // number of buffers
+    uint32_t used; // bitmask of buffers in use
+    struct pool_stats stats; // occupancy statistics
+};
+
+static struct pool pools[POOL_NUM_CLASSES] = {
+    [POOL_FRAME] = {
+        &pool_frame_stor[0][0], POOL_FRAME_SIZE, POOL_FRAME_COUNT, 0, { 0 }
+    },
+    [POOL_CHUNK] = {
+        &pool_chunk_stor[0][0], POOL_CHUNK_SIZE, POOL_CHUNK_COUNT, 0, { 0 }
+    }
+};
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void *pool_get(enum pool_class cls) {
+    struct pool *pool = &pools[cls];
+    void *buf = NULL;
+
+    taskENTER_CRITICAL(&pool_lock);
+    for (size_t i = 0; i < pool->count; i++) {
+        if (!(pool->used & (1UL << i))) {
+            pool->used |= 1UL << i;
+            buf = &pool->stor[i * pool->size];
+            if (++pool->stats.in_use > pool->stats.peak)
+                pool->stats.peak = pool->stats.in_use;
+            break;
+        }
+    }
+    if (!buf) pool->stats.failures++;
+    taskEXIT_CRITICAL(&pool_lock);
+
+    return buf;
+}
+
+void pool_put(void *buf) {
+    if (!buf) return;
+
+    for (size_t cls = 0; cls < POOL_NUM_CLASSES; cls++) {
+        struct pool *pool = &pools[cls];
+        uint8_t *p = (uint8_t *)buf;
+        if (p < pool->stor || p >= &pool->stor[pool->count * pool->size])
+            continue; // not from this pool
+
+        size_t i = (p - pool->stor) / pool->size;
+        assert(p == &pool->stor[i * pool->size]); // must be start of buffer
+        taskENTER_CRITICAL(&pool_lock);
+        assert(pool->used & (1UL << i)); // double free
+        pool->used &= ~(1UL << i);
+        pool->stats.in_use--;
+        taskEXIT_CRITICAL(&pool_lock);
+        return;
+    }
+
+    assert(false); // not a pool buffer
+}
+
+size_t pool_size(enum pool_class cls) {
+    return pools[cls].size;
+}
+
+void pool_get_stats(enum pool_class cls, struct pool_stats *stats) {
+    taskENTER_CRITICAL(&pool_lock);
+    *stats = pools[cls].stats;
+    taskEXIT_CRITICAL(&pool_lock);
+}
+
+#if POOL_ALLOC_GUARD
+
+#include <esp_heap_caps.h>
+
+#if !CONFIG_HEAP_USE_HOOKS // selected by the Kconfig option
+#error "POOL_ALLOC_GUARD requires CONFIG_HEAP_USE_HOOKS to be enabled"
+#endif
+
+/* guarded section nesting of a task */
+struct pool_guard_task {
+    TaskHandle_t task; // the task (NULL if slot is unused)
+    uint8_t depth; // guarded section nesting depth
+};
+
+static struct pool_guard_task pool_guard_tasks[POOL_GUARD_MAX_TASKS];
+static volatile bool pool_guard_armed = false;
+static struct pool_guard_stats pool_guard_stats;
+static TaskHandle_t pool_guard_last_task = NULL; // task of last violation
+static portMUX_TYPE pool_guard_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+ *  Heap allocation hook (CONFIG_HEAP_USE_HOOKS), called by ESP-IDF after
+ *  every successful allocation.
+ *  Inputs:
+ *   - ptr  : The allocated block.
+ *   - size : The requested size.
+ *   - caps : The requested memory capabilities.
+ *  Output: None.
+ */
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size,
+                                         uint32_t caps) {
+    (void) caps;
+    if (!pool_guard_armed || !ptr || xPortInIsrContext()) return;
+
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    bool guarded = false;
+    taskENTER_CRITICAL(&pool_guard_lock);
+    pool_guard_stats.allocs++;
+    pool_guard_stats.bytes += size;
+    for (size_t i = 0; i < POOL_GUARD_MAX_TASKS; i++) {
+        if (pool_guard_tasks[i].task == task && pool_guard_tasks[i].depth) {
+            guarded = true;
+            break;
+        }
+    }
+    if (guarded) {
+        pool_guard_stats.violations++;
+        pool_guard_stats.last_size = size;
+        pool_guard_last_task = task;
+    }
+    taskEXIT_CRITICAL(&pool_guard_lock);
+
+#if POOL_ALLOC_GUARD >= 2
+    if (guarded) abort(); // NOTE: logging here could allocate again
+#endif
+}
+
+void pool_guard_arm() {
+    pool_guard_armed = true;
+    ESP_LOGI(TAG, "allocation guard armed");
+}
+
+/*
+ * static void pool_guard_nest(int delta)
+ *  Adjusts the calling task's guarded section nesting depth. The depth
+ *  saturates at 0, so that an unbalanced pool_guard_end() cannot wrap it
+ *  around and guard the task for good (this aborts in test builds).
+ *  Inputs:
+ *   - delta : The depth adjustment (1 on entry, -1 on exit).
+ *  Output: None.
+ */
+static void pool_guard_nest(int delta) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    taskENTER_CRITICAL(&pool_guard_lock);
+    struct pool_guard_task *slot = NULL;
+    bool underflow = false;
+    for (size_t i = 0; i < POOL_GUARD_MAX_TASKS; i++) {
+        if (pool_guard_tasks[i].task == task) {
+            slot = &pool_guard_tasks[i];
+            break;
+        }
+        if (!slot && !pool_guard_tasks[i].task) slot = &pool_guard_tasks[i];
+    }
+    if (slot) {
+        slot->task = task;
+        underflow = delta < 0 && slot->depth < -delta;
+        slot->depth = (underflow) ? 0 : slot->depth + delta;
+    }
+    taskEXIT_CRITICAL(&pool_guard_lock);
+
+    assert(slot); // POOL_GUARD_MAX_TASKS too small
+#if POOL_ALLOC_GUARD >= 2
+    assert(!underflow); // pool_guard_end() outside a guarded section
+#else
+    (void) underflow;
+#endif
+}
+
+void pool_guard_begin() {
+    pool_guard_nest(1);
+}
+
+void pool_guard_end() {
+    pool_guard_nest(-1);
+}
+
+void pool_guard_get_stats(struct pool_guard_stats *stats) {
+    taskENTER_CRITICAL(&pool_guard_lock);
+    *stats = pool_guard_stats;
+    TaskHandle_t task = pool_guard_last_task;
+    taskEXIT_CRITICAL(&pool_guard_lock);
+
+    stats->last_task = (task) ? pcTaskGetName(task) : NULL;
+}
+
+#else
+
+void pool_guard_arm() {}
+void pool_guard_begin() {}
+void pool_guard_end() {}
+
+void pool_guard_get_stats(struct pool_guard_stats *stats) {
+    memset(stats, 0, sizeof(struct pool_guard_stats));
+}
+
+#endif
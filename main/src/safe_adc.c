@@ -1,4 +1,5 @@
 #include "safe_adc.h"
+#include "trace.h"
 
 #include <esp_log.h>
 #include <esp_check.h>
@@ -16,6 +17,94 @@ static SemaphoreHandle_t adc_mutex;
 
 #define TAG                                 "adc"
 
+/*
+ * Calibration cache. The line fitting curve is close to linear, so the table
+ * is stored piecewise: each segment of ADC_LUT_SEG_LEN codes holds its
+ * minimum voltage along with 8-bit offsets from it, which takes about half
+ * the space of a full int16_t table.
+ */
+struct adc_lut_seg {
+    int16_t base; // minimum voltage in segment (mV)
+    uint8_t offset[ADC_LUT_SEG_LEN]; // voltage offsets from base (mV)
+};
+static struct adc_lut_seg adc_lut[(ADC_RAW_MAX + 1) / ADC_LUT_SEG_LEN];
+static bool adc_lut_ready = false; // set if cache can be used
+
+/*
+ * static esp_err_t adc_lut_build()
+ *  Builds the calibration cache from the calibration driver.
+ *  Inputs: None.
+ *  Output: ESP_OK on success, or ESP_ERR_INVALID_SIZE if the calibration
+ *          curve does not fit into the piecewise representation.
+ */
+static esp_err_t adc_lut_build() {
+    for (size_t seg = 0; seg < sizeof(adc_lut) / sizeof(adc_lut[0]); seg++) {
+        int voltages[ADC_LUT_SEG_LEN];
+        int base = INT16_MAX;
+        for (size_t i = 0; i < ADC_LUT_SEG_LEN; i++) {
+            ESP_RETURN_ON_ERROR(
+                adc_cali_raw_to_voltage(
+                    adc_calib, seg * ADC_LUT_SEG_LEN + i, &voltages[i]
+                ),
+                TAG, "cannot convert raw ADC value"
+            );
+            if (voltages[i] < base) base = voltages[i];
+        }
+
+        adc_lut[seg].base = base;
+        for (size_t i = 0; i < ADC_LUT_SEG_LEN; i++) {
+            int offset = voltages[i] - base;
+            ESP_RETURN_ON_FALSE(
+                offset <= UINT8_MAX, ESP_ERR_INVALID_SIZE, TAG,
+                "calibration curve too steep for LUT (segment %u)", seg
+            );
+            adc_lut[seg].offset[i] = offset;
+        }
+    }
+    return ESP_OK;
+}
+
+int adc_raw_to_mv(int raw) {
+    if (raw < 0 || raw > ADC_RAW_MAX) return -1;
+    if (adc_lut_ready) {
+        const struct adc_lut_seg *seg = &adc_lut[raw / ADC_LUT_SEG_LEN];
+        return seg->base + seg->offset[raw % ADC_LUT_SEG_LEN];
+    }
+
+    /* fall back to calibration driver */
+    int voltage;
+    if (adc_cali_raw_to_voltage(adc_calib, raw, &voltage) != ESP_OK) {
+        ESP_LOGE(TAG, "cannot convert raw ADC value (%d) to voltage", raw);
+        return -1;
+    }
+    return voltage;
+}
+
+esp_err_t adc_lut_verify() {
+    size_t mismatches = 0;
+    for (int raw = 0; raw <= ADC_RAW_MAX; raw++) {
+        const struct adc_lut_seg *seg = &adc_lut[raw / ADC_LUT_SEG_LEN];
+        int expected;
+        ESP_RETURN_ON_ERROR(
+            adc_cali_raw_to_voltage(adc_calib, raw, &expected),
+            TAG, "cannot convert raw ADC value (%d) to voltage", raw
+        );
+        int actual = seg->base + seg->offset[raw % ADC_LUT_SEG_LEN];
+        if (actual != expected) {
+            if (!mismatches++)
+                ESP_LOGE(
+                    TAG, "LUT mismatch at code %d: %d mV (expected %d mV)",
+                    raw, actual, expected
+                );
+        }
+    }
+    if (mismatches) {
+        ESP_LOGE(TAG, "%u LUT mismatches", mismatches);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
 void adc_init() {
     /* initalise ADC unit */
     adc_oneshot_unit_init_cfg_t unit_config = {
@@ -28,7 +117,7 @@ void adc_init() {
     /* retrieve calibration */
     adc_cali_line_fitting_config_t calib_config = {
         /* unit_id */ ADC_UNIT_1, // ADC1 (GPIO 32-39)
-        /* atten */ ADC_ATTEN_DB_12, // max attenuation for max voltage range
+        /* atten */ ADC_ATTEN, // max attenuation for max voltage range
         /* bitwidth */ ADC_BITWIDTH_DEFAULT
 
     };
@@ -36,36 +125,58 @@ void adc_init() {
         &calib_config, &adc_calib
     ));
 
+    /* build calibration cache */
+    adc_lut_ready = adc_lut_build() == ESP_OK;
+#if ADC_LUT_VERIFY
+    if (adc_lut_ready) adc_lut_ready = adc_lut_verify() == ESP_OK;
+#endif
+    if (!adc_lut_ready)
+        ESP_LOGW(TAG, "calibration cache unavailable - using driver");
+
     adc_mutex = xSemaphoreCreateMutexStatic(&adc_mutex_buf);
 }
 
 void adc_init_channel(adc_channel_t channel) {
     adc_oneshot_chan_cfg_t config = {
-        ADC_ATTEN_DB_12, ADC_BITWIDTH_DEFAULT
+        ADC_ATTEN, ADC_BITWIDTH_DEFAULT
     };
+    while (!xSemaphoreTake(adc_mutex, portMAX_DELAY)); // may run concurrently
     ESP_ERROR_CHECK(adc_oneshot_config_channel(adc_unit, channel, &config));
+    xSemaphoreGive(adc_mutex);
 }
 
-esp_err_t adc_read(adc_channel_t channel, int *voltage, TickType_t max_wait) {
-    if (!adc_unit || !adc_calib || !voltage || !adc_mutex)
+esp_err_t adc_read_raw(adc_channel_t channel, int *raw, TickType_t max_wait) {
+    if (!adc_unit || !raw || !adc_mutex)
         return ESP_ERR_INVALID_STATE; // not initialised yet
 
-    if (!xSemaphoreTake(adc_mutex, max_wait))
+    trace_record(TRACE_ADC_BEGIN, channel, 0); // including mutex wait
+    if (!xSemaphoreTake(adc_mutex, max_wait)) {
+        trace_record(TRACE_ADC_END, channel, UINT32_MAX);
         return ESP_ERR_TIMEOUT; // mutex timeout
-
-    int raw; // raw ADC output
-    if (adc_oneshot_read(adc_unit, channel, &raw) != ESP_OK) {
-        ESP_LOGE(TAG, "cannot read from channel %u", channel);
-        xSemaphoreGive(adc_mutex);
-        return ESP_ERR_INVALID_RESPONSE;
     }
 
-    if (adc_cali_raw_to_voltage(adc_calib, raw, voltage) != ESP_OK) {
-        ESP_LOGE(TAG, "cannot convert raw ADC value (%d) to voltage", raw);
+    if (adc_oneshot_read(adc_unit, channel, raw) != ESP_OK) {
+        ESP_LOGE(TAG, "cannot read from channel %u", channel);
         xSemaphoreGive(adc_mutex);
+        trace_record(TRACE_ADC_END, channel, UINT32_MAX);
         return ESP_ERR_INVALID_RESPONSE;
     }
 
     xSemaphoreGive(adc_mutex);
+    trace_record(TRACE_ADC_END, channel, *raw);
+    return ESP_OK;
+}
+
+esp_err_t adc_read(adc_channel_t channel, int *voltage, TickType_t max_wait) {
+    if (!adc_calib || !voltage)
+        return ESP_ERR_INVALID_STATE; // not initialised yet
+
+    int raw; // raw ADC output
+    esp_err_t ret = adc_read_raw(channel, &raw, max_wait);
+    if (ret != ESP_OK) return ret;
+
+    *voltage = adc_raw_to_mv(raw); // outside of critical section
+    if (*voltage < 0) return ESP_ERR_INVALID_RESPONSE;
+
     return ESP_OK;
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "state.h"
+
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include <math.h>
+#include <stdatomic.h>
+
+static struct st_snapshot st_state = { .temp = NAN };
+static atomic_uint_least32_t st_seq; // seqlock sequence (odd while writing)
+static portMUX_TYPE st_lock = portMUX_INITIALIZER_UNLOCKED; // among writers
+
+/*
+ * NOTE: writers update the state inside a critical section, so that they
+ * cannot be preempted by a reader on the same core (which would otherwise
+ * spin on the odd sequence number forever).
+ */
+
+/*
+ * static void st_write_begin()
+ *  Starts an update of the state. This must be called in the critical
+ *  section.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void st_write_begin() {
+    uint32_t seq = atomic_load_explicit(&st_seq, memory_order_relaxed);
+    atomic_store_explicit(&st_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // odd before data
+}
+
+/*
+ * static void st_write_end()
+ *  Completes an update of the state. This must be called in the critical
+ *  section.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void st_write_end() {
+    st_state.version++;
+    uint32_t seq = atomic_load_explicit(&st_seq, memory_order_relaxed);
+    atomic_store_explicit(&st_seq, seq + 1, memory_order_release);
+        // data before even
+}
+
+void st_read(struct st_snapshot *snapshot) {
+    uint32_t start, end;
+    do {
+        start = atomic_load_explicit(&st_seq, memory_order_acquire);
+        *snapshot = st_state;
+        atomic_thread_fence(memory_order_acquire); // data before re-check
+        end = atomic_load_explicit(&st_seq, memory_order_relaxed);
+    } while ((start & 1) || start != end); // retry if an update intervened
+}
+
+void st_set_temp(float temp) {
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&st_lock);
+    st_write_begin();
+    st_state.temp = temp; st_state.temp_stamp = now;
+    st_write_end();
+    taskEXIT_CRITICAL(&st_lock);
+}
+
+void st_set_occupancy(bool occupancy) {
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&st_lock);
+    st_write_begin();
+    st_state.occupancy = occupancy; st_state.occ_stamp = now;
+    st_write_end();
+    taskEXIT_CRITICAL(&st_lock);
+}
+
+void st_set_help(bool help) {
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&st_lock);
+    st_write_begin();
+    st_state.help = help; st_state.help_stamp = now;
+    st_write_end();
+    taskEXIT_CRITICAL(&st_lock);
+}
@@ -1,37 +1,35 @@
 #include "thermistor.h"
-#include "vdiv.h"
 #include "safe_adc.h"
 #include "priorities.h"
 #include "sense_events.h"
+#include "boot.h"
+#include "uplink.h"
+#include "pool.h"
+#include "state.h"
 
 #include <esp_log.h>
 
 #include <math.h>
-#include <string.h>
 
 #include <driver/gpio.h>
 
+#include <freertos/semphr.h>
+
 #define TAG                         "thermistor" // for logging
 
-#define T_KELVIN                    273.15 // 0C in Kelvin
+static struct ts_block rt_history_blocks[RT_HISTORY_SIZE / TS_BLOCK_SIZE];
+struct ts_store rt_history;
 
-/*
- * static float rt_calc(int voltage)
- *  Calculates the temperature given the thermistor's measurement.
- *  Inputs:
- *   - voltage : The measured voltage across the thermistor's pulldown resistor
- *               in mV.
- *  Output: The applied force in C.
- */
-static float rt_calc(int voltage) {
-    float R = calc_resistance(voltage, RT_R_PD); // calculate resistance
-    float T = 1 / (log(R / RT_R0) / RT_B + 1 / (RT_t0 + T_KELVIN));
-        // NOTE: see 5.2D task submission for explanation
-    return T - T_KELVIN;
+static StaticSemaphore_t rt_history_mutex_buf; // backing memory for mutex
+static SemaphoreHandle_t rt_history_mutex;
+
+void rt_history_lock() {
+    while (!xSemaphoreTake(rt_history_mutex, portMAX_DELAY));
 }
 
-float rt_history[RT_HISTORY_LEN];
-float *rt_latest_temp = &rt_history[RT_HISTORY_LEN - 1];
+void rt_history_unlock() {
+    xSemaphoreGive(rt_history_mutex);
+}
 
 /* LED timer */
 static TimerHandle_t rt_led_timer;
@@ -65,15 +63,18 @@ static StackType_t rt_task_stack[STACK_SIZE];
  *  Output: None.
  */
 static void rt_task(void *parameter) {
+    pool_guard_begin(); // no heap allocations expected from here on
     while (true) {
         float temp = rt_read(portMAX_DELAY); // read temperature
+        if (!isnan(temp)) boot_mark(BOOT_MARK_FIRST_TEMP); // not if failed
         ESP_LOGI(TAG, "temperature: %.2f C", temp);
         
         /* log to history */
-        memmove(
-            rt_history, &rt_history[1], (RT_HISTORY_LEN - 1) * sizeof(float)
-        ); // shift up by 1 element
-        *rt_latest_temp = temp;
+        rt_history_lock();
+        ts_append(&rt_history, temp);
+        rt_history_unlock();
+        st_set_temp(temp);
+        if (!isnan(temp)) ul_push(UL_RECORD_TEMP, lroundf(temp * 100));
 
         /* start/stop LED blinking */
         if (temp >= RT_LED_THRESHOLD) {
@@ -97,7 +98,11 @@ static void rt_task(void *parameter) {
 void rt_init() {
     adc_init_channel(RT_PIN_CHANNEL);
     
-    for (size_t i = 0; i < RT_HISTORY_LEN; i++) rt_history[i] = NAN;
+    ts_init(
+        &rt_history, rt_history_blocks,
+        sizeof(rt_history_blocks) / sizeof(struct ts_block)
+    );
+    rt_history_mutex = xSemaphoreCreateMutexStatic(&rt_history_mutex_buf);
     
     /* configure LED pin */
     gpio_config_t config = {
@@ -125,5 +130,5 @@ void rt_init() {
 float rt_read(TickType_t max_wait) {
     int voltage;
     if (adc_read(RT_PIN_CHANNEL, &voltage, max_wait) != ESP_OK) return NAN;
-    return rt_calc(voltage);
+    return RT_CALC(voltage);
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#include <esp_attr.h>
+#include <esp_cpu.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define TAG                         "trace" // for logging
+
+_Static_assert(
+    (TRACE_RING_LEN & (TRACE_RING_LEN - 1)) == 0,
+    "TRACE_RING_LEN must be a power of 2"
+);
+_Static_assert(
+    sizeof(struct trace_record) == 12, "unexpected trace record padding"
+);
+
+static struct trace_record trace_ring[TRACE_RING_LEN];
+static atomic_uint_least32_t trace_head; // records reserved since arming
+static atomic_bool trace_on; // set while armed
+static atomic_uint_least32_t trace_writers; // records being written
+static uint32_t trace_count; // number of records in frozen recording
+
+/*
+ * NOTE: writers reserve a slot with a single atomic increment and then fill
+ * it in, so recording never blocks or disables interrupts. Writers count
+ * themselves in trace_writers before checking trace_on, so that once the
+ * recorder has been stopped and the count has dropped to zero, no record
+ * can be written anymore (see trace_drain()).
+ */
+void IRAM_ATTR trace_record(uint8_t type, uint16_t arg16, uint32_t arg) {
+    atomic_fetch_add(&trace_writers, 1);
+    if (atomic_load(&trace_on)) {
+        uint32_t index =
+            atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+        struct trace_record *record =
+            &trace_ring[index & (TRACE_RING_LEN - 1)];
+        record->stamp = (uint32_t)esp_timer_get_time();
+        record->type = type;
+        record->core = esp_cpu_get_core_id();
+        record->arg16 = arg16;
+        record->arg = arg;
+    }
+    atomic_fetch_sub(&trace_writers, 1);
+}
+
+void IRAM_ATTR trace_task_switched_in() {
+    trace_record(TRACE_TASK_IN, 0, (uint32_t)xTaskGetCurrentTaskHandle());
+}
+
+void IRAM_ATTR trace_event_group_set(uint32_t bits) {
+    trace_record(TRACE_EVENT_SET, 0, bits);
+}
+
+void trace_init() {
+    if (TRACE_ARM_AT_BOOT) trace_arm();
+}
+
+/*
+ * static void trace_drain()
+ *  Stops recording and waits for records still being written (e.g. by a
+ *  preempted task) to be finished.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void trace_drain() {
+    atomic_store(&trace_on, false);
+    while (atomic_load(&trace_writers)) vTaskDelay(1);
+}
+
+void trace_arm() {
+    trace_drain(); // so that no stale record lands in the new recording
+    trace_count = 0;
+    atomic_store(&trace_head, 0);
+    atomic_store(&trace_on, true);
+    ESP_LOGI(TAG, "armed");
+}
+
+bool trace_armed() {
+    return atomic_load(&trace_on);
+}
+
+static TaskStatus_t trace_task_status[TRACE_MAX_TASKS];
+
+void trace_freeze() {
+    if (!atomic_load(&trace_on)) return; // not armed (or already frozen)
+    trace_drain();
+
+    uint32_t total = atomic_load(&trace_head);
+    trace_count = (total < TRACE_RING_LEN) ? total : TRACE_RING_LEN;
+    ESP_LOGI(
+        TAG, "frozen with %lu records (%lu taken)",
+        (unsigned long)trace_count, (unsigned long)total
+    );
+}
+
+size_t trace_dump(struct trace_header *header, struct trace_task *tasks) {
+    uint32_t total = (trace_count) ? atomic_load(&trace_head) : 0;
+
+    /* list tasks (to name the handles in TRACE_TASK_IN records) */
+    UBaseType_t num_tasks =
+        uxTaskGetSystemState(trace_task_status, TRACE_MAX_TASKS, NULL);
+    if (!num_tasks) ESP_LOGW(TAG, "too many tasks to list");
+    for (UBaseType_t i = 0; i < num_tasks; i++) {
+        memset(&tasks[i], 0, sizeof(struct trace_task));
+        tasks[i].handle = (uint32_t)trace_task_status[i].xHandle;
+        strncpy(
+            tasks[i].name, trace_task_status[i].pcTaskName,
+            TRACE_TASK_NAME_LEN
+        );
+    }
+
+    memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(struct trace_record);
+    header->num_tasks = num_tasks;
+    header->num_records = trace_count;
+    header->total = total;
+    return trace_count;
+}
+
+size_t trace_read(size_t first, struct trace_record *buf, size_t len) {
+    if (first >= trace_count) return 0;
+    if (len > trace_count - first) len = trace_count - first;
+
+    uint32_t oldest = atomic_load(&trace_head) - trace_count;
+    for (size_t i = 0; i < len; i++)
+        buf[i] = trace_ring[(oldest + first + i) & (TRACE_RING_LEN - 1)];
+    return len;
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "tscomp.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TS_VARINT_MAX               5 // max length of a 32-bit varint
+
+/*
+ * static int32_t ts_to_fixed(float value)
+ *  Converts a sample to fixed point.
+ *  Inputs:
+ *   - value : The sample to be converted.
+ *  Output: The fixed point sample, or TS_NAN if the sample is NAN.
+ */
+static int32_t ts_to_fixed(float value) {
+    if (isnan(value)) return TS_NAN;
+    float scaled = roundf(value * TS_SCALE);
+    if (scaled > INT16_MAX) return INT16_MAX; // saturate
+    if (scaled < -INT16_MAX) return -INT16_MAX; // INT16_MIN is reserved
+    return (int32_t)scaled;
+}
+
+/*
+ * static float ts_from_fixed(int32_t value)
+ *  Converts a fixed point sample back to floating point.
+ *  Inputs:
+ *   - value : The fixed point sample.
+ *  Output: The sample, or NAN if value is TS_NAN.
+ */
+static float ts_from_fixed(int32_t value) {
+    if (value == TS_NAN) return NAN;
+    return (float)value / TS_SCALE;
+}
+
+/*
+ * static size_t ts_varint_encode(int32_t value, uint8_t *buf)
+ *  Zigzag-encodes a signed value and writes it out as a varint.
+ *  Inputs:
+ *   - value : The value to be encoded.
+ *   - buf   : The output buffer (at least TS_VARINT_MAX bytes long).
+ *  Output: The number of bytes written.
+ */
+static size_t ts_varint_encode(int32_t value, uint8_t *buf) {
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); // zigzag
+    size_t len = 0;
+    while (zz >= 0x80) {
+        buf[len++] = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    buf[len++] = (uint8_t)zz;
+    return len;
+}
+
+/*
+ * static int32_t ts_varint_decode(const uint8_t *buf, size_t *pos)
+ *  Reads a varint and reverses its zigzag encoding.
+ *  Inputs:
+ *   - buf : The input buffer.
+ *   - pos : Pointer to the read offset, which will be advanced past the
+ *           varint.
+ *  Output: The decoded value.
+ */
+static int32_t ts_varint_decode(const uint8_t *buf, size_t *pos) {
+    uint32_t zz = 0;
+    for (size_t shift = 0; shift < 32; shift += 7) {
+        uint8_t byte = buf[(*pos)++];
+        zz |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1); // reverse zigzag
+}
+
+void ts_init(struct ts_store *store, struct ts_block *blocks,
+             size_t num_blocks) {
+    memset(store, 0, sizeof(struct ts_store));
+    store->blocks = blocks;
+    store->num_blocks = num_blocks;
+}
+
+void ts_append(struct ts_store *store, float value) {
+    int32_t sample = ts_to_fixed(value);
+
+    if (store->used) {
+        /* try to append to the newest block */
+        struct ts_block *block = &store->blocks[
+            (store->head + store->used - 1) % store->num_blocks
+        ];
+        int32_t delta = sample - store->last;
+        uint8_t buf[TS_VARINT_MAX];
+        size_t len = ts_varint_encode(delta - store->last_delta, buf);
+        if (
+                block->count < UINT8_MAX
+            &&  block->len + len <= sizeof(block->data)
+        ) {
+            memcpy(&block->data[block->len], buf, len);
+            block->len += len; block->count++;
+            store->last = sample; store->last_delta = delta;
+            store->count++;
+            return;
+        }
+    }
+
+    /* start a new block */
+    if (store->used == store->num_blocks) { // evict oldest block
+        store->count -= store->blocks[store->head].count;
+        store->head = (store->head + 1) % store->num_blocks;
+        store->used--;
+    }
+    struct ts_block *block = &store->blocks[
+        (store->head + store->used) % store->num_blocks
+    ];
+    store->used++;
+    block->first = (int16_t)sample; block->count = 1; block->len = 0;
+    store->last = sample; store->last_delta = 0;
+    store->count++;
+}
+
+void ts_copy(struct ts_store *dst, struct ts_block *blocks,
+             const struct ts_store *src) {
+    *dst = *src;
+    dst->blocks = blocks;
+    memcpy(blocks, src->blocks, src->num_blocks * sizeof(struct ts_block));
+}
+
+size_t ts_bytes_used(const struct ts_store *store) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < store->used; i++) {
+        bytes += 4 + store->blocks[
+            (store->head + i) % store->num_blocks
+        ].len; // 4 byte header
+    }
+    return bytes;
+}
+
+void ts_iter_init(struct ts_iter *it, const struct ts_store *store) {
+    memset(it, 0, sizeof(struct ts_iter));
+    it->store = store;
+}
+
+bool ts_iter_next(struct ts_iter *it, float *value) {
+    const struct ts_store *store = it->store;
+
+    for (; it->block < store->used; it->block++, it->sample = 0) {
+        const struct ts_block *block = &store->blocks[
+            (store->head + it->block) % store->num_blocks
+        ];
+        if (it->sample >= block->count) continue; // block exhausted
+
+        if (it->sample == 0) { // first sample is stored verbatim
+            it->value = block->first; it->delta = 0; it->pos = 0;
+        } else {
+            it->delta += ts_varint_decode(block->data, &it->pos);
+            it->value += it->delta;
+        }
+        it->sample++;
+
+        *value = ts_from_fixed(it->value);
+        return true;
+    }
+
+    return false;
+}
+
+size_t ts_iter_skip(struct ts_iter *it, size_t n) {
+    const struct ts_store *store = it->store;
+    size_t skipped = 0;
+    float dummy;
+
+    while (skipped < n && it->block < store->used) {
+        const struct ts_block *block = &store->blocks[
+            (store->head + it->block) % store->num_blocks
+        ];
+        size_t remaining = block->count - it->sample;
+        if (it->sample == 0 && remaining <= n - skipped) {
+            /* skip entire block without decoding */
+            skipped += remaining;
+            it->block++;
+        } else if (ts_iter_next(it, &dummy)) skipped++;
+        else break;
+    }
+
+    return skipped;
+}
+
+size_t ts_format(struct ts_iter *it, char *buf, size_t max, bool comma,
+                 size_t *count) {
+    size_t len = 0, n = 0;
+    float value;
+    buf[0] = '\0';
+    while (n < max && ts_iter_next(it, &value)) {
+        if (isnan(value)) continue; // skip NaN entries (failed readings)
+        len += sprintf(&buf[len], (comma || n) ? ",%3.2f" : "%3.2f", value);
+        n++;
+    }
+    *count = n;
+    return len;
+}
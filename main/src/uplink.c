@@ -0,0 +1,222 @@
+#include "uplink.h"
+#include "priorities.h"
+
+#include <esp_log.h>
+#include <esp_mac.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <mqtt_client.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define TAG                                 "uplink"
+
+/*
+ * Record queue. Records are only popped once the broker has acknowledged
+ * the batch containing them (or when the queue overflows).
+ */
+static struct ul_record ul_queue[UL_QUEUE_LEN];
+static uint32_t ul_head = 0; // write index (= seq of next record)
+static uint32_t ul_tail = 0; // read index (= seq of oldest record)
+static uint32_t ul_dropped = 0; // records dropped on overflow
+static bool ul_urgent = false; // set if queue is to be flushed immediately
+static size_t ul_inflight = 0; // records in unacknowledged batch
+static int ul_inflight_id = -1; // message ID of unacknowledged batch
+static int ul_last_ack = -1; // message ID of last acknowledgement
+static portMUX_TYPE ul_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_mqtt_client_handle_t ul_client;
+static char ul_topic[sizeof(UL_TOPIC_PREFIX) + 12 + sizeof("/records")];
+static uint32_t ul_boot_id;
+static volatile bool ul_connected = false;
+
+static uint8_t ul_batch[
+    sizeof(struct ul_header) + UL_BATCH_RECORDS * sizeof(struct ul_record)
+]; // batch being published
+
+/* task support structures */
+static TaskHandle_t ul_task_handle = NULL;
+static StaticTask_t ul_task_buf; // TCB
+static StackType_t ul_task_stack[UL_STACK_SIZE];
+
+void ul_push(uint8_t type, int16_t value) {
+    struct ul_record record = {
+        (uint32_t)(esp_timer_get_time() / 1000), type, 0, value
+    };
+
+    taskENTER_CRITICAL(&ul_lock);
+    if (ul_head - ul_tail >= UL_QUEUE_LEN) { // full - drop oldest record
+        ul_tail++; ul_dropped++;
+        if (ul_inflight) ul_inflight--; // so its ack pops one less record
+    }
+    ul_queue[ul_head++ % UL_QUEUE_LEN] = record;
+    if (type == UL_RECORD_HELP) ul_urgent = true;
+    size_t queued = ul_head - ul_tail;
+    taskEXIT_CRITICAL(&ul_lock);
+
+    if (ul_task_handle && (type == UL_RECORD_HELP || queued >= UL_BATCH_MIN))
+        xTaskNotifyGive(ul_task_handle);
+}
+
+/*
+ * static bool ul_ack(int msg_id)
+ *  Handles the acknowledgement of a published batch, popping its records
+ *  from the queue. Must be called with ul_lock held.
+ *  Inputs:
+ *   - msg_id : The acknowledged message ID.
+ *  Output: true if there are enough records left for another batch.
+ */
+static bool ul_ack(int msg_id) {
+    if (msg_id != ul_inflight_id) { // not (yet) known to be in flight
+        ul_last_ack = msg_id;
+        return false;
+    }
+    ul_tail += ul_inflight;
+    ul_inflight = 0; ul_inflight_id = -1;
+    ul_last_ack = -1; // consumed (IDs are reused, so it must not linger)
+    size_t queued = ul_head - ul_tail;
+    return queued >= UL_BATCH_MIN || (queued && ul_urgent);
+}
+
+/*
+ * static void ul_task(void *parameter)
+ *  Task function for the uplink task, which publishes batches of records
+ *  when there are enough records queued, when the oldest record has been
+ *  queued for UL_BATCH_PERIOD, or when a flush is requested.
+ *  Inputs:
+ *   - parameter: Parameter from xTaskCreateStatic - ignored.
+ *  Output: None.
+ */
+static void ul_task(void *parameter) {
+    (void) parameter;
+    struct ul_header *header = (struct ul_header *)ul_batch;
+    struct ul_record *records = (struct ul_record *)(header + 1);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UL_BATCH_PERIOD / 4));
+        if (!ul_connected) continue;
+        uint32_t now = esp_timer_get_time() / 1000;
+
+        /* prepare batch */
+        size_t count = 0;
+        taskENTER_CRITICAL(&ul_lock);
+        size_t queued = ul_head - ul_tail;
+        if (ul_inflight_id < 0 && !ul_inflight && queued && (
+                ul_urgent || queued >= UL_BATCH_MIN
+            ||  now - ul_queue[ul_tail % UL_QUEUE_LEN].time >= UL_BATCH_PERIOD
+        )) {
+            count = (queued < UL_BATCH_RECORDS) ? queued : UL_BATCH_RECORDS;
+            for (size_t i = 0; i < count; i++)
+                records[i] = ul_queue[(ul_tail + i) % UL_QUEUE_LEN];
+            header->seq = ul_tail;
+            header->dropped = (ul_dropped > UINT16_MAX)
+                ? UINT16_MAX : ul_dropped;
+            ul_inflight = count; ul_urgent = false;
+        }
+        taskEXIT_CRITICAL(&ul_lock);
+        if (!count) continue;
+
+        /* publish batch */
+        header->version = UL_VERSION;
+        header->count = count;
+        header->boot_id = ul_boot_id;
+        header->sent = now;
+        int msg_id = esp_mqtt_client_publish(
+            ul_client, ul_topic, (const char *)ul_batch,
+            sizeof(struct ul_header) + count * sizeof(struct ul_record),
+            UL_QOS, 0
+        );
+
+        bool more = false;
+        taskENTER_CRITICAL(&ul_lock);
+        if (msg_id < 0) { // failed - retry later
+            ul_inflight = 0;
+            ul_urgent = true;
+        } else {
+            ul_inflight_id = (UL_QOS) ? msg_id : 0; // QoS 0 - no ack coming
+            if (!UL_QOS || ul_last_ack == msg_id) more = ul_ack(msg_id);
+        }
+        taskEXIT_CRITICAL(&ul_lock);
+
+        if (msg_id < 0) {
+            ESP_LOGW(
+                TAG, "cannot publish batch of %u records", (unsigned)count
+            );
+        } else ESP_LOGD(TAG, "published batch of %u records", (unsigned)count);
+        if (more) xTaskNotifyGive(ul_task_handle);
+    }
+}
+
+/*
+ * static void ul_mqtt_handler(void *arg, esp_event_base_t event_base,
+ *                             int32_t event_id, void *event_data)
+ *  Handler for MQTT client events.
+ *  Inputs:
+ *   - arg        : Arbitrary argument passed from ESP-IDF; ignored.
+ *   - event_base : The event's source.
+ *   - event_id   : The event's identifier.
+ *   - event_data : The MQTT event (esp_mqtt_event_handle_t).
+ *  Output: None.
+ */
+static void ul_mqtt_handler(void *arg, esp_event_base_t event_base,
+                            int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+    bool notify = false;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "connected to broker");
+            taskENTER_CRITICAL(&ul_lock);
+            ul_urgent = ul_head != ul_tail; // flush backlog
+            taskEXIT_CRITICAL(&ul_lock);
+            ul_connected = true; notify = true;
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "disconnected from broker");
+            ul_connected = false;
+            taskENTER_CRITICAL(&ul_lock);
+            ul_inflight = 0; ul_inflight_id = -1; // republish on reconnect
+            ul_last_ack = -1; // no acknowledgements carry over
+            taskEXIT_CRITICAL(&ul_lock);
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            taskENTER_CRITICAL(&ul_lock);
+            notify = ul_ack(event->msg_id);
+            taskEXIT_CRITICAL(&ul_lock);
+            break;
+        default:
+            break;
+    }
+
+    if (notify) xTaskNotifyGive(ul_task_handle);
+}
+
+void ul_init() {
+    uint8_t mac[6];
+    ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
+    snprintf(
+        ul_topic, sizeof(ul_topic), UL_TOPIC_PREFIX "%02x%02x%02x%02x%02x%02x"
+        "/records", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]
+    );
+    ul_boot_id = esp_random();
+
+    ul_task_handle = xTaskCreateStatic(
+        ul_task, TAG, UL_STACK_SIZE, NULL, MIN_PRIORITY,
+        ul_task_stack, &ul_task_buf
+    );
+
+    esp_mqtt_client_config_t config = {
+        .broker.address.uri = UL_BROKER_URI
+    };
+    ul_client = esp_mqtt_client_init(&config);
+    assert(ul_client);
+    ESP_ERROR_CHECK(esp_mqtt_client_register_event(
+        ul_client, ESP_EVENT_ANY_ID, ul_mqtt_handler, NULL
+    ));
+    ESP_ERROR_CHECK(esp_mqtt_client_start(ul_client));
+    ESP_LOGI(TAG, "publishing to %s on %s", ul_topic, UL_BROKER_URI);
+}
@@ -3,15 +3,28 @@
 #include <esp_log.h>
 #include <esp_check.h>
 #include <esp_http_server.h>
-#include <esp_wifi.h>
-#include <nvs_flash.h>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 
 #include "thermistor.h"
 #include "fsr.h"
 #include "sense_events.h"
 #include "priorities.h"
+#include "wifi_mgr.h"
+#include "boot.h"
+#include "uplink.h"
+#include "pool.h"
+#include "ota.h"
+#include "trace.h"
+#include "state.h"
 
 #include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #define TAG                                 "web"
 
@@ -51,6 +64,7 @@ esp_err_t web_serve_static(httpd_req_t *req) {
     return ESP_OK;
 }
 
+#ifdef WEB_EMBED_CHARTJS // index.htm only requests it in such builds
 extern const uint8_t chart_min_js_start[]
     asm("_binary_chart_umd_min_js_start");
 extern const uint8_t chart_min_js_end[]
@@ -63,6 +77,18 @@ static const httpd_uri_t web_get_chart_min_js = {
         "application/javascript"
     }
 };
+#endif
+
+extern const uint8_t plot_js_start[] asm("_binary_plot_js_start");
+extern const uint8_t plot_js_end[] asm("_binary_plot_js_end");
+static const httpd_uri_t web_get_plot_js = {
+    "/plot.js", HTTP_GET,
+    web_serve_static,
+    (const void *)&(struct web_static){
+        plot_js_start, plot_js_end,
+        "application/javascript"
+    }
+};
 
 extern const uint8_t index_htm_start[] asm("_binary_index_htm_start");
 extern const uint8_t index_htm_end[] asm("_binary_index_htm_end");
@@ -94,43 +120,160 @@ static const httpd_uri_t web_get_alert_mp3 = {
     }
 };
 
+/*
+ * static esp_err_t web_ws_send_frame(int fd, httpd_ws_frame_t *frame)
+ *  Sends a WebSocket frame to the specified client, logging any failure.
+ *  Inputs:
+ *   - fd    : The client's file descriptor.
+ *   - frame : The frame to be sent.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t web_ws_send_frame(int fd, httpd_ws_frame_t *frame) {
+    trace_record(TRACE_WS_BEGIN, fd, frame->len);
+    pool_guard_end(); // NOTE: lwIP allocates pbufs from the heap
+    esp_err_t ret = httpd_ws_send_frame_async(web_handle, fd, frame);
+    pool_guard_begin();
+    trace_record(TRACE_WS_END, fd, ret);
+    if (ret != ESP_OK)
+        ESP_LOGE(
+            TAG, "cannot send WebSocket data to client fd %d (%s)",
+            fd, esp_err_to_name(ret)
+        );
+    else ESP_LOGD(TAG, "sent WebSocket data to client %d", fd);
+    return ret;
+}
+
+/*
+ * static void web_ws_send_pooled(int fd, char *buf, size_t len)
+ *  Sends a text message held in a pooled frame buffer to the specified
+ *  client, then returns the buffer to the pool.
+ *  Inputs:
+ *   - fd  : The client's file descriptor.
+ *   - buf : The frame buffer (see pool_get()).
+ *   - len : The message's length.
+ *  Output: None.
+ */
+static void web_ws_send_pooled(int fd, char *buf, size_t len) {
+    httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
+    frame.payload = (uint8_t *)buf;
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.len = len;
+    web_ws_send_frame(fd, &frame);
+    pool_put(buf);
+}
+
+/*
+ * static void web_ws_send_text(int fd, const char *fmt, ...)
+ *  Formats and sends a text message to the specified client, using a pooled
+ *  frame buffer.
+ *  Inputs:
+ *   - fd  : The client's file descriptor.
+ *   - fmt : The message's format string, followed by its arguments.
+ *  Output: None.
+ */
+static void web_ws_send_text(int fd, const char *fmt, ...) {
+    char *buf = pool_get(POOL_FRAME);
+    if (!buf) {
+        ESP_LOGW(TAG, "no frame buffer for client fd %d", fd);
+        return;
+    }
+
+    va_list args; va_start(args, fmt);
+    int len = vsnprintf(buf, POOL_FRAME_SIZE, fmt, args);
+    va_end(args);
+    web_ws_send_pooled(
+        fd, buf, (len < POOL_FRAME_SIZE) ? len : POOL_FRAME_SIZE - 1
+    );
+}
+
+/*
+ * static void web_ws_send_update(int fd, enum web_topic topic, float value)
+ *  Sends a t:, o: or h: update message (see web_format_update()) to the
+ *  specified client, using a pooled frame buffer.
+ *  Inputs:
+ *   - fd    : The client's file descriptor.
+ *   - topic : The message's topic.
+ *   - value : The temperature or status.
+ *  Output: None.
+ */
+static void web_ws_send_update(int fd, enum web_topic topic, float value) {
+    char *buf = pool_get(POOL_FRAME);
+    if (!buf) {
+        ESP_LOGW(TAG, "no frame buffer for client fd %d", fd);
+        return;
+    }
+
+    size_t len = web_format_update(buf, POOL_FRAME_SIZE, topic, value);
+    web_ws_send_pooled(fd, buf, len);
+}
+
+_Static_assert(
+    WEB_UPDATE_MAX_LEN <= POOL_FRAME_SIZE,
+    "update messages do not fit in frame buffers"
+);
+_Static_assert(
+    2 + TS_FORMAT_MAX_LEN * WEB_TEMPS_CHUNK + 1 <= POOL_FRAME_SIZE,
+    "temperature fragments do not fit in frame buffers"
+); // 2 byte header + formatted elements + null termination
+
+/* history copy for web_ws_send_all_temps() (only used by the httpd task) */
+static struct ts_block web_history_blocks[RT_HISTORY_SIZE / TS_BLOCK_SIZE];
+static struct ts_store web_history;
+
 /*
  * static void web_ws_send_all_temps(void *arg)
- *  Sends all logged temperatures to the specified client.
+ *  Sends all logged temperatures to the specified client. The history is
+ *  decoded and sent in fragments of WEB_TEMPS_CHUNK entries, so that it never
+ *  needs to be decompressed in its entirety. This decodes a copy of the
+ *  (compressed) history, so that rt_task is never held up by a slow client.
  *  Inputs:
  *   - arg : The client's file descriptor.
  *  Output: None.
  */
 static void web_ws_send_all_temps(void *arg) {
+    int fd = (int)arg;
+    char *buf = pool_get(POOL_FRAME);
+    if (!buf) {
+        ESP_LOGW(TAG, "no frame buffer for client fd %d", fd);
+        return;
+    }
+
     httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
-    frame.payload = malloc(7 * RT_HISTORY_LEN + 3);
-        // 7 chars per element (incl. comma) + 2 byte header + null termination
-    assert(frame.payload);
+    frame.payload = (uint8_t *)buf;
     frame.type = HTTPD_WS_TYPE_TEXT;
-    int fd = (int)arg;
+    frame.fragmented = true;
+    esp_err_t ret = ESP_OK;
 
-    /* prepare payload */
-    frame.payload[0] = 'T'; frame.payload[1] = ':';
-    // while (!xSemaphoreTake(rt_data_mutex, portMAX_DELAY));
+    /* prepare and send payload */
+    buf[0] = 'T'; buf[1] = ':';
     frame.len = 2;
-    for (size_t i = 0; i < RT_HISTORY_LEN; i++) {
-        if (isnan(rt_history[i])) continue; // skip NaN entries in the beginning
-        frame.len += // excluding null termination
-            sprintf(
-                (char *)&frame.payload[frame.len], "%3.2f,", rt_history[i]
-            );
+    bool first = true; // set until the first element (no leading comma)
+    rt_history_lock();
+    ts_copy(&web_history, web_history_blocks, &rt_history);
+    rt_history_unlock();
+    struct ts_iter it; ts_iter_init(&it, &web_history);
+    if (web_history.count > RT_HISTORY_LEN)
+        ts_iter_skip(&it, web_history.count - RT_HISTORY_LEN);
+    while (ret == ESP_OK) {
+        size_t chunk; // number of elements in current fragment
+        frame.len += ts_format( // excluding null termination
+            &it, &buf[frame.len], WEB_TEMPS_CHUNK, !first, &chunk
+        );
+        if (chunk) first = false;
+        if (chunk < WEB_TEMPS_CHUNK) break; // history exhausted
+
+        /* send fragment */
+        frame.final = false;
+        ret = web_ws_send_frame(fd, &frame);
+        frame.type = HTTPD_WS_TYPE_CONTINUE; // for subsequent fragments
+        frame.len = 0;
     }
-    // xSemaphoreGive(rt_data_mutex);
-    if (frame.len > 2) frame.len--; // cut off the final comma
 
-    esp_err_t ret = httpd_ws_send_frame_async(web_handle, fd, &frame);
-    free(frame.payload);
-    if (ret != ESP_OK)
-        ESP_LOGE(
-            TAG, "cannot send WebSocket data to client fd %d (%s)",
-            fd, esp_err_to_name(ret)
-        );
-    else ESP_LOGD(TAG, "sent WebSocket data to client %d", fd);
+    if (ret == ESP_OK) { // send final fragment
+        frame.final = true;
+        web_ws_send_frame(fd, &frame);
+    }
+    pool_put(buf);
 }
 
 /*
@@ -141,22 +284,8 @@ static void web_ws_send_all_temps(void *arg) {
  *  Output: None.
  */
 static void web_ws_send_last_temp(void *arg) {
-    char buf[2 + 6 + 1]; // 2 byte header + 6 chars (max) + null termination
-    httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
-    frame.payload = (uint8_t *)buf;
-    frame.type = HTTPD_WS_TYPE_TEXT;
-    int fd = (int)arg;
-
-    volatile float temp = *rt_latest_temp; // atomic
-    frame.len = sprintf(buf, "t:%3.2f", temp);
-
-    esp_err_t ret = httpd_ws_send_frame_async(web_handle, fd, &frame);
-    if (ret != ESP_OK)
-        ESP_LOGE(
-            TAG, "cannot send WebSocket data to client fd %d (%s)",
-            fd, esp_err_to_name(ret)
-        );
-    else ESP_LOGD(TAG, "sent WebSocket data to client %d", fd);
+    struct st_snapshot state; st_read(&state);
+    web_ws_send_update((int)arg, WEB_TOPIC_TEMP, state.temp);
 }
 
 /*
@@ -168,26 +297,10 @@ static void web_ws_send_last_temp(void *arg) {
  *  Output: None.
  */
 static void web_ws_send_occupancy(void *arg) {
-    char buf[2 + 1 + 1] = "o:\0"; // 2 byte header + 1 char + null termination
-    httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
-    frame.payload = (uint8_t *)buf;
-    frame.type = HTTPD_WS_TYPE_TEXT;
-    int fd = (int)arg;
-
-    frame.payload[2] = fsr_occupancy ? '1' : '0';
-    frame.len = 3;
-
-    esp_err_t ret = httpd_ws_send_frame_async(web_handle, fd, &frame);
-    if (ret != ESP_OK)
-        ESP_LOGE(
-            TAG, "cannot send WebSocket data to client fd %d (%s)",
-            fd, esp_err_to_name(ret)
-        );
-    else ESP_LOGD(TAG, "sent WebSocket data to client %d", fd);
+    struct st_snapshot state; st_read(&state);
+    web_ws_send_update((int)arg, WEB_TOPIC_OCC, state.occupancy);
 }
 
-static bool web_help = false; // set when help is signalled
-
 /*
  * static void web_ws_send_help(void *arg)
  *  Sends help request status (0/1) to the specified client.
@@ -196,49 +309,210 @@ static bool web_help = false; // set when help is signalled
  *  Output: None.
  */
 static void web_ws_send_help(void *arg) {
-    char buf[2 + 1 + 1] = "h:\0"; // 2 byte header + 1 char + null termination
-    httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
-    frame.payload = (uint8_t *)buf;
-    frame.type = HTTPD_WS_TYPE_TEXT;
-    int fd = (int)arg;
+    struct st_snapshot state; st_read(&state);
+    web_ws_send_update((int)arg, WEB_TOPIC_HELP, state.help);
+}
 
-    frame.payload[2] = web_help ? '1' : '0';
-    frame.len = 3;
+/*
+ * static void web_ws_send_metrics(void *arg)
+ *  Sends runtime metrics (uptime in seconds, free heap, minimum free heap,
+ *  number of WebSocket clients, last WiFi connection duration in ms, time
+ *  from boot to first IP in ms, WiFi connection attempts, largest free heap
+ *  block, frame buffers in use, peak frame buffers in use, peak response
+ *  chunk buffers in use, failed pool requests, heap allocations since boot
+ *  and allocation guard violations) to the specified client.
+ *  Inputs:
+ *   - arg : The client's file descriptor.
+ *  Output: None.
+ */
+static void web_ws_send_metrics(void *arg);
 
-    esp_err_t ret = httpd_ws_send_frame_async(web_handle, fd, &frame);
-    if (ret != ESP_OK)
-        ESP_LOGE(
-            TAG, "cannot send WebSocket data to client fd %d (%s)",
-            fd, esp_err_to_name(ret)
+/* WebSocket client subscription */
+struct web_sub {
+    int fd; // client's file descriptor (-1 if slot is unused)
+    uint8_t topics; // bitmask of subscribed topics (1 << WEB_TOPIC_x)
+    uint32_t interval; // min interval between stream updates (ms)
+    int64_t last_sent[WEB_NUM_TOPICS]; // last update timestamps (us)
+    uint8_t pending; // stream topics with a rate limited update to deliver
+    uint8_t scope_decimate; // send 1 in every N scope batches (backpressure)
+    uint8_t scope_skip; // scope batches left to skip
+};
+
+/*
+ * NOTE: the subscription table is only accessed from the HTTPD task (URI
+ * handlers, session close callback and queued work), so it needs no locking.
+ */
+static struct web_sub web_subs[WEB_MAX_CLIENTS];
+static volatile uint8_t web_topic_subs[WEB_NUM_TOPICS]; // subscriber counts
+static volatile bool web_pending; // set while any client has pending updates
+
+static const char web_topic_chars[WEB_NUM_TOPICS] = {
+    't', 'o', 'h', 'f', 'm'
+}; // topic characters in subscription messages
+
+/*
+ * static struct web_sub *web_sub_find(int fd, bool create)
+ *  Retrieves the subscription entry of a client.
+ *  Inputs:
+ *   - fd     : The client's file descriptor.
+ *   - create : Whether to allocate a new entry if there is none.
+ *  Output: Pointer to the subscription entry, or NULL if not found.
+ */
+static struct web_sub *web_sub_find(int fd, bool create) {
+    struct web_sub *empty = NULL;
+    for (size_t i = 0; i < WEB_MAX_CLIENTS; i++) {
+        if (web_subs[i].fd == fd) return &web_subs[i];
+        if (!empty && web_subs[i].fd < 0) empty = &web_subs[i];
+    }
+    if (!create || !empty) return NULL;
+
+    memset(empty, 0, sizeof(struct web_sub));
+    empty->fd = fd;
+    return empty;
+}
+
+/*
+ * static void web_sub_set(struct web_sub *sub, uint8_t topics,
+ *                         uint32_t interval)
+ *  Updates a client's subscription along with the subscriber counts.
+ *  Inputs:
+ *   - sub      : The subscription entry.
+ *   - topics   : The new topic bitmask.
+ *   - interval : The new min interval between stream updates (ms).
+ *  Output: None.
+ */
+static void web_sub_set(struct web_sub *sub, uint8_t topics,
+                        uint32_t interval) {
+    bool scope = web_topic_subs[WEB_TOPIC_FORCE] > 0;
+    for (size_t i = 0; i < WEB_NUM_TOPICS; i++) {
+        if (sub->topics & (1 << i)) web_topic_subs[i]--;
+        if (topics & (1 << i)) web_topic_subs[i]++;
+    }
+    sub->topics = topics; sub->interval = interval;
+    sub->pending &= topics;
+    sub->scope_decimate = 1; sub->scope_skip = 0;
+
+    if (scope != (web_topic_subs[WEB_TOPIC_FORCE] > 0)) { // start/stop scope
+        fsr_scope_enable(!scope);
+        ESP_LOGI(TAG, "scope streaming %s", (scope) ? "stopped" : "started");
+    }
+}
+
+/*
+ * static void web_close_fn(httpd_handle_t hd, int sockfd)
+ *  Session close callback for the HTTPD server. Removes the client's
+ *  subscription (if any) and closes its socket.
+ *  Inputs:
+ *   - hd     : The HTTPD server handle.
+ *   - sockfd : The client's file descriptor.
+ *  Output: None.
+ */
+static void web_close_fn(httpd_handle_t hd, int sockfd) {
+    (void) hd;
+    struct web_sub *sub = web_sub_find(sockfd, false);
+    if (sub) {
+        web_sub_set(sub, 0, 0);
+        sub->fd = -1;
+        ESP_LOGI(TAG, "WebSocket client with fd %d disconnected", sockfd);
+    }
+    close(sockfd);
+}
+
+/*
+ * static esp_err_t web_ws_subscribe(int fd, const char *msg)
+ *  Parses a subscription message from a client and updates its
+ *  subscription. Subscription messages take the form of
+ *  "s:<topics>[,<interval>]", where <topics> is a combination of topic
+ *  characters (see web_topic_chars) and <interval> is the minimum interval
+ *  between stream updates in milliseconds. An empty message subscribes to
+ *  the default topics (WEB_DEFAULT_TOPICS) without rate limiting.
+ *  Inputs:
+ *   - fd  : The client's file descriptor.
+ *   - msg : The null-terminated message.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t web_ws_subscribe(int fd, const char *msg) {
+    struct web_sub *sub = web_sub_find(fd, true);
+    ESP_RETURN_ON_FALSE(
+        sub, ESP_ERR_NO_MEM, TAG, "no subscription slot for client fd %d", fd
+    );
+
+    if (msg[0] == '\0') { // legacy (empty) message
+        web_sub_set(sub, WEB_DEFAULT_TOPICS, 0);
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_FALSE(
+        msg[0] == 's' && msg[1] == ':', ESP_ERR_INVALID_ARG, TAG,
+        "invalid message from client fd %d", fd
+    );
+    uint8_t topics = 0; uint32_t interval = 0;
+    for (msg += 2; *msg && *msg != ','; msg++) {
+        const char *topic = memchr(web_topic_chars, *msg, WEB_NUM_TOPICS);
+        ESP_RETURN_ON_FALSE(
+            topic, ESP_ERR_INVALID_ARG, TAG,
+            "invalid topic '%c' from client fd %d", *msg, fd
         );
-    else ESP_LOGD(TAG, "sent WebSocket data to client %d", fd);
+        topics |= 1 << (topic - web_topic_chars);
+    }
+    if (*msg == ',') interval = strtoul(msg + 1, NULL, 10);
+
+    web_sub_set(sub, topics, interval);
+    ESP_LOGI(
+        TAG, "client fd %d subscribed to topics 0x%02x (interval %lu ms)",
+        fd, topics, (unsigned long)interval
+    );
+    return ESP_OK;
 }
 
 /*
  * static esp_err_t web_ws_handler(httpd_req_t *req)
- *  Handler for incoming WebSocket clients. Sends initial data to connecting
- *  clients.
+ *  Handler for incoming WebSocket clients. Processes subscription messages
+ *  and sends initial data for the subscribed topics.
  *  Inputs:
  *   - req : The client's HTTP request.
- *  Output: ESP_OK.
+ *  Output: ESP_OK on success, otherwise a corresponding error code (which
+ *          causes the client to be disconnected).
  */
 static esp_err_t web_ws_handler(httpd_req_t *req) {
     int fd = httpd_req_to_sockfd(req);
 
     if (req->method == HTTP_GET) {
         ESP_LOGI(TAG, "new client connected to WebSocket with fd %d", fd);
+        struct web_sub *sub = web_sub_find(fd, true);
+        if (sub) web_sub_set(sub, WEB_DEFAULT_TOPICS, 0); // defaults for now
         return ESP_OK;
     }
 
     /* we assume any request past this point to be WebSocket */
 
+    char msg[WEB_WS_MAX_MSG + 1];
     httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
-    ESP_ERROR_CHECK(httpd_ws_recv_frame(req, &frame, 0));
+    ESP_RETURN_ON_ERROR(
+        httpd_ws_recv_frame(req, &frame, 0), TAG,
+        "cannot receive frame length from client fd %d", fd
+    );
+    ESP_RETURN_ON_FALSE(
+        frame.len <= WEB_WS_MAX_MSG, ESP_ERR_INVALID_SIZE, TAG,
+        "message from client fd %d is too long", fd
+    );
+    frame.payload = (uint8_t *)msg;
+    ESP_RETURN_ON_ERROR(
+        httpd_ws_recv_frame(req, &frame, WEB_WS_MAX_MSG), TAG,
+        "cannot receive frame from client fd %d", fd
+    );
+    msg[frame.len] = '\0';
+    if (frame.type != HTTPD_WS_TYPE_TEXT) return ESP_OK; // ignore others
+
+    ESP_RETURN_ON_ERROR(web_ws_subscribe(fd, msg), TAG, "subscription failed");
 
-    /* regardless of the actual data, we'll send the complete data over */
-    web_ws_send_all_temps((void *)fd);
-    web_ws_send_occupancy((void *)fd);
-    web_ws_send_help((void *)fd);
+    /* send initial data for subscribed topics */
+    pool_guard_begin();
+    struct web_sub *sub = web_sub_find(fd, false);
+    if (sub->topics & (1 << WEB_TOPIC_TEMP)) web_ws_send_all_temps((void *)fd);
+    if (sub->topics & (1 << WEB_TOPIC_OCC)) web_ws_send_occupancy((void *)fd);
+    if (sub->topics & (1 << WEB_TOPIC_HELP)) web_ws_send_help((void *)fd);
+    pool_guard_end();
 
     return ESP_OK;
 }
@@ -250,35 +524,281 @@ static const httpd_uri_t web_ws = {
     .is_websocket = true
 };
 
+/*
+ * Scope frame (binary, little endian):
+ *  - 0  : 'f'
+ *  - 1  : flags (bit 0 = millivolts included)
+ *  - 2  : number of samples (uint16)
+ *  - 4  : sequence number of first sample (uint32)
+ *  - 8  : number of samples dropped by the sensing task so far (uint32)
+ *  - 12 : sampling interval in ms (uint16)
+ *  - 14 : reserved (uint16)
+ *  - 16 : samples - force in grams (uint16, 0xFFFF if reading failed),
+ *         followed by ADC millivolts (uint16) if flag bit 0 is set
+ */
+#define WEB_SCOPE_HDR_LEN                   16
+#define WEB_SCOPE_SAMPLE_LEN                (2 + 2 * FSR_SCOPE_WITH_MV)
+_Static_assert(
+    WEB_SCOPE_HDR_LEN + WEB_SCOPE_SAMPLE_LEN * FSR_SCOPE_BATCH
+        <= POOL_FRAME_SIZE,
+    "scope frames do not fit in frame buffers"
+);
+
+/*
+ * prepared broadcast frame - a pooled buffer held by web_ws_broadcast() for
+ * broadcasts with a prepare function
+ */
+static uint8_t *web_bcast_frame = NULL;
+static size_t web_bcast_len; // length of prepared frame
+
+/*
+ * static bool web_scope_prepare()
+ *  Pops a batch of raw force samples and prepares a scope frame from it.
+ *  Inputs: None.
+ *  Output: true if a frame has been prepared, or false if no batch is ready.
+ */
+static bool web_scope_prepare() {
+    struct fsr_scope_sample samples[FSR_SCOPE_BATCH];
+    uint32_t seq, dropped;
+    size_t count = fsr_scope_read(samples, FSR_SCOPE_BATCH, &seq, &dropped);
+    if (!count) return false;
+
+    uint8_t *p = web_bcast_frame;
+    *(p++) = 'f'; *(p++) = FSR_SCOPE_WITH_MV;
+    *(p++) = count & 0xFF; *(p++) = count >> 8;
+    for (size_t i = 0; i < 4; i++) *(p++) = (seq >> (8 * i)) & 0xFF;
+    for (size_t i = 0; i < 4; i++) *(p++) = (dropped >> (8 * i)) & 0xFF;
+    *(p++) = FSR_INTERVAL & 0xFF; *(p++) = FSR_INTERVAL >> 8;
+    *(p++) = 0; *(p++) = 0;
+    for (size_t i = 0; i < count; i++) {
+        *(p++) = samples[i].force & 0xFF; *(p++) = samples[i].force >> 8;
+#if FSR_SCOPE_WITH_MV
+        *(p++) = samples[i].voltage & 0xFF; *(p++) = samples[i].voltage >> 8;
+#endif
+    }
+    web_bcast_len = p - web_bcast_frame;
+
+    return true;
+}
 
 /*
- * static void web_ws_send_all(httpd_work_fn_t func)
- *  Stages the provided function (which can be and of the web_ws_send_x
- *  functions above) to execute for all connected clients. This can be used to
- *  broadcast a message to all clients.
+ * static void web_ws_send_scope(void *arg)
+ *  Sends the prepared scope frame to the specified client. Clients that
+ *  cannot keep up (i.e. sending takes longer than WEB_SCOPE_SLOW_SEND) have
+ *  their stream decimated by skipping batches, so that a slow client cannot
+ *  stall the others; the decimation is relaxed again once sends are fast.
  *  Inputs:
- *   - func : The send function to use.
+ *   - arg : The client's file descriptor.
  *  Output: None.
  */
-static void web_ws_send_all(httpd_work_fn_t func) {
-    /* get all FDs of connected clients */
-    int client_fds[CONFIG_LWIP_MAX_LISTENING_TCP];
-    size_t fds = CONFIG_LWIP_MAX_LISTENING_TCP;
-    ESP_ERROR_CHECK(httpd_get_client_list(web_handle, &fds, client_fds));
-
-    for (size_t i = 0; i < fds; i++) {
-        httpd_ws_client_info_t info = 
-            httpd_ws_get_fd_info(web_handle, client_fds[i]);
-        if (info == HTTPD_WS_CLIENT_WEBSOCKET) {
-            ESP_LOGD(
-                TAG, "staging WebSocket transmission for client fd %d",
-                client_fds[i]
+static void web_ws_send_scope(void *arg) {
+    int fd = (int)arg;
+    struct web_sub *sub = web_sub_find(fd, false);
+    if (!sub) return;
+    if (sub->scope_skip) { // decimated
+        sub->scope_skip--;
+        return;
+    }
+
+    httpd_ws_frame_t frame; memset(&frame, 0, sizeof(httpd_ws_frame_t));
+    frame.payload = web_bcast_frame;
+    frame.len = web_bcast_len;
+    frame.type = HTTPD_WS_TYPE_BINARY;
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = web_ws_send_frame(fd, &frame);
+    int64_t duration = esp_timer_get_time() - start;
+    if (ret != ESP_OK) return;
+
+    if (duration > WEB_SCOPE_SLOW_SEND * 1000LL) { // back off
+        if (sub->scope_decimate < WEB_SCOPE_MAX_DECIMATE) {
+            sub->scope_decimate *= 2;
+            ESP_LOGW(
+                TAG, "client fd %d is slow - decimating scope by %u",
+                fd, sub->scope_decimate
             );
-            ESP_ERROR_CHECK(
-                httpd_queue_work(web_handle, func, (void*)client_fds[i])
+        }
+    } else if (sub->scope_decimate > 1) sub->scope_decimate /= 2; // recover
+    sub->scope_skip = sub->scope_decimate - 1;
+}
+
+/* broadcast definition */
+struct web_broadcast {
+    enum web_topic topic; // topic of the broadcast
+    bool stream; // whether the broadcast is subject to rate limiting
+    httpd_work_fn_t func; // send function
+    bool (*prepare)(); // called to prepare each frame (NULL if unused)
+};
+
+static const struct web_broadcast web_broadcasts[WEB_NUM_TOPICS] = {
+    { WEB_TOPIC_TEMP, true, web_ws_send_last_temp, NULL },
+    { WEB_TOPIC_OCC, false, web_ws_send_occupancy, NULL },
+    { WEB_TOPIC_HELP, false, web_ws_send_help, NULL },
+    { WEB_TOPIC_FORCE, true, web_ws_send_scope, web_scope_prepare },
+    { WEB_TOPIC_METRICS, true, web_ws_send_metrics, NULL }
+};
+
+/*
+ * static void web_ws_fan_out(const struct web_broadcast *bcast)
+ *  Sends the current frame of a broadcast to all eligible clients.
+ *  Inputs:
+ *   - bcast : The broadcast definition.
+ *  Output: None.
+ */
+static void web_ws_fan_out(const struct web_broadcast *bcast) {
+    int64_t now = esp_timer_get_time();
+
+    for (size_t i = 0; i < WEB_MAX_CLIENTS; i++) {
+        struct web_sub *sub = &web_subs[i];
+        if (sub->fd < 0 || !(sub->topics & (1 << bcast->topic))) continue;
+        if (
+                bcast->stream
+            &&  now - sub->last_sent[bcast->topic] < sub->interval * 1000LL
+        ) { // rate limited
+            if (!bcast->prepare) { // deliver latest value once interval ends
+                sub->pending |= 1 << bcast->topic;
+                web_pending = true;
+            }
+            continue;
+        }
+        if (
+                httpd_ws_get_fd_info(web_handle, sub->fd)
+            !=  HTTPD_WS_CLIENT_WEBSOCKET
+        ) continue; // not (yet) a WebSocket client
+
+        ESP_LOGD(
+            TAG, "sending topic '%c' to client fd %d",
+            web_topic_chars[bcast->topic], sub->fd
+        );
+        sub->last_sent[bcast->topic] = now;
+        sub->pending &= ~(1 << bcast->topic);
+        bcast->func((void *)sub->fd);
+    }
+}
+
+/*
+ * static void web_ws_broadcast(void *arg)
+ *  Sends a broadcast to all clients subscribed to its topic, deferring it
+ *  for those whose update interval has not elapsed yet (see
+ *  web_ws_flush_pending()). State updates (occupancy and
+ *  help) are never rate limited, as they would otherwise be lost. Broadcasts
+ *  with a prepare function are repeated until there are no frames left to
+ *  prepare, with each frame prepared in a pooled buffer. This must be
+ *  executed in the HTTPD task.
+ *  Inputs:
+ *   - arg : The broadcast definition (struct web_broadcast).
+ *  Output: None.
+ */
+static void web_ws_broadcast(void *arg) {
+    const struct web_broadcast *bcast = (const struct web_broadcast *)arg;
+
+    pool_guard_begin();
+    if (bcast->prepare) {
+        web_bcast_frame = pool_get(POOL_FRAME);
+        if (!web_bcast_frame) {
+            ESP_LOGW(
+                TAG, "no frame buffer for topic '%c'",
+                web_topic_chars[bcast->topic]
             );
+            pool_guard_end();
+            return;
+        }
+    }
+
+    do {
+        if (bcast->prepare && !bcast->prepare()) break; // nothing (left)
+        web_ws_fan_out(bcast);
+    } while (bcast->prepare);
+
+    pool_put(web_bcast_frame); web_bcast_frame = NULL;
+    pool_guard_end();
+}
+
+/*
+ * static void web_ws_flush_pending(void *arg)
+ *  Delivers rate limited stream updates to the clients whose update
+ *  interval has since elapsed, so that a client's last update is never
+ *  lost (trailing edge). The latest value is sent, as send functions read
+ *  the current state. Scope batches are not delivered late, as skipping
+ *  them is what rate limiting them means. This must be executed in the
+ *  HTTPD task.
+ *  Inputs:
+ *   - arg : Ignored.
+ *  Output: None.
+ */
+static void web_ws_flush_pending(void *arg) {
+    (void) arg;
+    int64_t now = esp_timer_get_time();
+    bool pending = false;
+
+    pool_guard_begin();
+    for (size_t i = 0; i < WEB_MAX_CLIENTS; i++) {
+        struct web_sub *sub = &web_subs[i];
+        if (sub->fd < 0 || !sub->pending) continue;
+        for (size_t topic = 0; topic < WEB_NUM_TOPICS; topic++) {
+            if (!(sub->pending & (1 << topic))) continue;
+            if (now - sub->last_sent[topic] < sub->interval * 1000LL) {
+                pending = true; // not yet
+                continue;
+            }
+            sub->pending &= ~(1 << topic);
+            sub->last_sent[topic] = now;
+            web_broadcasts[topic].func((void *)sub->fd);
         }
     }
+    web_pending = pending;
+    pool_guard_end();
+}
+
+/*
+ * static void web_ws_send_all(enum web_topic topic)
+ *  Stages a broadcast of the specified topic to all subscribed clients.
+ *  This must be called inside a guarded section (see pool_guard_begin()),
+ *  which is lifted around the network stack.
+ *  Inputs:
+ *   - topic : The topic to broadcast.
+ *  Output: None.
+ */
+static void web_ws_send_all(enum web_topic topic) {
+    if (!web_topic_subs[topic] || !web_broadcasts[topic].func)
+        return; // no one is listening (or nothing to send)
+
+    pool_guard_end(); // NOTE: lwIP allocates pbufs from the heap
+    esp_err_t ret = httpd_queue_work(
+        web_handle, web_ws_broadcast, (void *)&web_broadcasts[topic]
+    );
+    pool_guard_begin();
+    if (ret != ESP_OK)
+        ESP_LOGW(
+            TAG, "cannot stage broadcast of topic '%c' (%s)",
+            web_topic_chars[topic], esp_err_to_name(ret)
+        );
+}
+
+static void web_ws_send_metrics(void *arg) {
+    size_t clients = 0;
+    for (size_t i = 0; i < WEB_MAX_CLIENTS; i++) {
+        if (web_subs[i].fd >= 0) clients++;
+    }
+    struct wm_stats wifi; wm_get_stats(&wifi);
+    struct pool_stats frames; pool_get_stats(POOL_FRAME, &frames);
+    struct pool_stats chunks; pool_get_stats(POOL_CHUNK, &chunks);
+    struct pool_guard_stats guard; pool_guard_get_stats(&guard);
+
+    web_ws_send_text(
+        (int)arg, "m:%lu,%lu,%lu,%u,%lu,%lu,%lu,%lu,%u,%u,%u,%lu,%lu,%lu",
+        (unsigned long)(esp_timer_get_time() / 1000000),
+        (unsigned long)esp_get_free_heap_size(),
+        (unsigned long)esp_get_minimum_free_heap_size(),
+        (unsigned)clients,
+        (unsigned long)wifi.last_connect_ms,
+        (unsigned long)(wifi.first_ip_us / 1000),
+        (unsigned long)wifi.attempts,
+        (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+        frames.in_use, frames.peak, chunks.peak,
+        (unsigned long)(frames.failures + chunks.failures),
+        (unsigned long)guard.allocs, (unsigned long)guard.violations
+    );
 }
 
 /*
@@ -289,9 +809,12 @@ static void web_ws_send_all(httpd_work_fn_t func) {
  *  Output: ESP_OK on success.
  */
 static esp_err_t web_clear_help(httpd_req_t *req) {
-    web_help = false;
+    pool_guard_begin();
+    st_set_help(false);
+    ul_push(UL_RECORD_HELP, 0);
+    web_ws_send_all(WEB_TOPIC_HELP); // broadcast new help status
+    pool_guard_end();
     ESP_LOGI(TAG, "help request cleared");
-    web_ws_send_all(web_ws_send_help); // broadcast new help status
     return httpd_resp_send(req, NULL, 0);
 }
 
@@ -300,42 +823,307 @@ static const httpd_uri_t web_post_clear = {
     web_clear_help
 };
 
-/* all URI handlers */
-const httpd_uri_t *web_handlers[] = {
-    &web_get_index_htm, &web_get_root,
-    &web_get_alert_mp3, &web_get_chart_min_js, 
-    &web_ws, &web_post_clear
+/*
+ * static esp_err_t web_boot_report(httpd_req_t *req)
+ *  Serves the boot timing report (see boot_report()) as JSON.
+ *  Inputs:
+ *   - req : Request data from HTTPD.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t web_boot_report(httpd_req_t *req) {
+    char *buf = pool_get(POOL_CHUNK);
+    if (!buf) {
+        ESP_LOGW(TAG, "no response buffer for boot report");
+        return httpd_resp_send_err(
+            req, HTTPD_500_INTERNAL_SERVER_ERROR, "no response buffer"
+        );
+    }
+    size_t len = boot_report(buf, POOL_CHUNK_SIZE);
+    if (len >= POOL_CHUNK_SIZE) len = POOL_CHUNK_SIZE - 1; // truncated
+
+    esp_err_t ret = httpd_resp_set_hdr(req, "Content-Type", "application/json");
+    if (ret == ESP_OK) ret = httpd_resp_send(req, buf, len);
+    pool_put(buf);
+    return ret;
+}
+
+static const httpd_uri_t web_get_boot = {
+    "/boot", HTTP_GET,
+    web_boot_report
 };
 
+#if TRACE_ENABLE
+_Static_assert(
+    sizeof(struct trace_header)
+        + TRACE_MAX_TASKS * sizeof(struct trace_task) <= POOL_CHUNK_SIZE,
+    "trace dump header does not fit in response chunk buffers"
+);
+
 /*
- * static void web_wifi_event_handler(void *arg, esp_event_base_t event_base,
- *                                    int32_t event_id, void *event_data)
- *  Handler for networking (WiFi/IP stack) events, including WiFi station
- *  starts, network disconnections, and IP address acquisition.
+ * static esp_err_t web_trace_dump(httpd_req_t *req)
+ *  Serves the frozen trace recording (see trace.h for the format) as a
+ *  download. This leaves the recorder alone, so a recorder that is still
+ *  armed is reported as a conflict rather than frozen.
  *  Inputs:
- *   - arg        : Arbitrary argument passed from ESP-IDF; ignored.
- *   - event_base : The event's source (WiFi or IP stack).
- *   - event_id   : The event's identifier.
- *   - event_data : Arbitrary data supplied along with the event.
- *  Output: None.
+ *   - req : Request data from HTTPD.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t web_trace_dump(httpd_req_t *req) {
+    if (trace_armed()) {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_sendstr(
+            req, "recorder armed - POST /trace/freeze first"
+        );
+    }
+
+    uint8_t *buf = pool_get(POOL_CHUNK);
+    if (!buf) {
+        ESP_LOGW(TAG, "no response buffer for trace dump");
+        return httpd_resp_send_err(
+            req, HTTPD_500_INTERNAL_SERVER_ERROR, "no response buffer"
+        );
+    }
+
+    /* header and task list */
+    struct trace_header header;
+    size_t count = trace_dump(
+        &header, (struct trace_task *)&buf[sizeof(struct trace_header)]
+    );
+    memcpy(buf, &header, sizeof(struct trace_header));
+    esp_err_t ret = httpd_resp_set_type(req, "application/octet-stream");
+    if (ret == ESP_OK) ret = httpd_resp_set_hdr(
+        req, "Content-Disposition", "attachment; filename=\"trace.bin\""
+    );
+    if (ret == ESP_OK) ret = httpd_resp_send_chunk(
+        req, (const char *)buf, sizeof(struct trace_header)
+            + header.num_tasks * sizeof(struct trace_task)
+    );
+
+    /* records */
+    for (size_t i = 0; ret == ESP_OK && i < count;) {
+        size_t len = trace_read(
+            i, (struct trace_record *)buf,
+            POOL_CHUNK_SIZE / sizeof(struct trace_record)
+        );
+        ret = httpd_resp_send_chunk(
+            req, (const char *)buf, len * sizeof(struct trace_record)
+        );
+        i += len;
+    }
+    if (ret == ESP_OK) ret = httpd_resp_send_chunk(req, NULL, 0); // end
+
+    pool_put(buf);
+    return ret;
+}
+
+static const httpd_uri_t web_get_trace = {
+    "/trace", HTTP_GET,
+    web_trace_dump
+};
+
+/*
+ * static esp_err_t web_trace_arm(httpd_req_t *req)
+ *  Discards any trace recording and starts recording.
+ *  Inputs:
+ *   - req : Request data from HTTPD.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
  */
-static void web_wifi_event_handler(void *arg, esp_event_base_t event_base,
-                                   int32_t event_id, void *event_data){
+static esp_err_t web_trace_arm(httpd_req_t *req) {
+    trace_arm();
+    return httpd_resp_sendstr(req, "armed");
+}
+
+static const httpd_uri_t web_post_trace_arm = {
+    "/trace/arm", HTTP_POST,
+    web_trace_arm
+};
+
+/*
+ * static esp_err_t web_trace_freeze(httpd_req_t *req)
+ *  Stops trace recording, keeping the recording for GET /trace.
+ *  Inputs:
+ *   - req : Request data from HTTPD.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t web_trace_freeze(httpd_req_t *req) {
+    trace_freeze();
+    return httpd_resp_sendstr(req, "frozen");
+}
+
+static const httpd_uri_t web_post_trace_freeze = {
+    "/trace/freeze", HTTP_POST,
+    web_trace_freeze
+};
+#endif
+
+/*
+ * static esp_err_t web_ota_authorise(httpd_req_t *req)
+ *  Checks the update token (X-OTA-Token header) of a request against the
+ *  provisioned one (see ota_check_token()).
+ *  Inputs:
+ *   - req : Request data from HTTPD.
+ *  Output: ESP_OK if the token matches, ESP_ERR_NOT_FOUND if no token has
+ *          been provisioned, or ESP_ERR_INVALID_ARG otherwise.
+ */
+static esp_err_t web_ota_authorise(httpd_req_t *req) {
+    char token[OTA_TOKEN_MAX_LEN + 1] = "";
     if (
-        event_base == WIFI_EVENT && (
-            event_id == WIFI_EVENT_STA_START
-            || event_id == WIFI_EVENT_STA_DISCONNECTED
-        )
-    ) {
-        ESP_LOGI(TAG, "connecting/reconnecting to WiFi");
-        ESP_ERROR_CHECK(esp_wifi_connect()); // connect/reconnect
-    }
-    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG, "IP address: " IPSTR, IP2STR(&event->ip_info.ip));
+            httpd_req_get_hdr_value_len(req, "X-OTA-Token")
+        >   OTA_TOKEN_MAX_LEN
+    ) return ESP_ERR_INVALID_ARG;
+    httpd_req_get_hdr_value_str(req, "X-OTA-Token", token, sizeof(token));
+        // NOTE: left empty if absent, which never matches
+    return ota_check_token(token);
+}
+
+/*
+ * static bool web_ota_hash(httpd_req_t *req, uint8_t *sha256)
+ *  Retrieves the expected image hash (X-OTA-SHA256 header, in hex) of a
+ *  request.
+ *  Inputs:
+ *   - req    : Request data from HTTPD.
+ *   - sha256 : The output buffer (OTA_SHA256_LEN bytes).
+ *  Output: true if the hash is present and valid.
+ */
+static bool web_ota_hash(httpd_req_t *req, uint8_t *sha256) {
+    char hex[2 * OTA_SHA256_LEN + 1];
+    if (httpd_req_get_hdr_value_str(req, "X-OTA-SHA256", hex, sizeof(hex))
+            != ESP_OK || strlen(hex) != 2 * OTA_SHA256_LEN)
+        return false;
+
+    for (size_t i = 0; i < OTA_SHA256_LEN; i++) {
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' }; char *end;
+        sha256[i] = strtoul(byte, &end, 16);
+        if (*end) return false;
+    }
+    return true;
+}
+
+#define WEB_OTA_MAX_TIMEOUTS                5 // max receive timeouts in a row
+
+/*
+ * static esp_err_t web_ota(httpd_req_t *req)
+ *  Handles firmware updates. The image is streamed as the request body into
+ *  the inactive OTA partition, either raw or gzip compressed (with
+ *  Content-Encoding: gzip). The request must carry the update token in the
+ *  X-OTA-Token header and the SHA-256 hash of the uncompressed image in the
+ *  X-OTA-SHA256 header. On success, the update report is returned as JSON
+ *  and the unit restarts into the new image, which has to pass its
+ *  self-test (see ota_self_test()) to be kept.
+ *  Inputs:
+ *   - req : Request data from HTTPD.
+ *  Output: ESP_OK on success, otherwise a corresponding error code.
+ */
+static esp_err_t web_ota(httpd_req_t *req) {
+    esp_err_t ret = web_ota_authorise(req);
+    if (ret == ESP_ERR_NOT_FOUND)
+        return httpd_resp_send_err(
+            req, HTTPD_403_FORBIDDEN, "no update token provisioned"
+        );
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "rejected unauthorised update");
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, NULL);
     }
+    uint8_t sha256[OTA_SHA256_LEN];
+    if (!web_ota_hash(req, sha256))
+        return httpd_resp_send_err(
+            req, HTTPD_400_BAD_REQUEST, "missing or invalid X-OTA-SHA256"
+        );
+    if (!req->content_len)
+        return httpd_resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, NULL);
+
+    char encoding[8] = "";
+    httpd_req_get_hdr_value_str(
+        req, "Content-Encoding", encoding, sizeof(encoding)
+    ); // NOTE: left empty if absent (or too long - not gzip either way)
+    bool gzip = !strcmp(encoding, "gzip");
+
+    char *buf = pool_get(POOL_CHUNK);
+    if (!buf) {
+        ESP_LOGW(TAG, "no response buffer for update");
+        return httpd_resp_send_err(
+            req, HTTPD_500_INTERNAL_SERVER_ERROR, "no receive buffer"
+        );
+    }
+    ret = ota_begin(gzip, sha256);
+    if (ret != ESP_OK) {
+        pool_put(buf);
+        return httpd_resp_send_err(
+            req, HTTPD_500_INTERNAL_SERVER_ERROR, "cannot begin update"
+        );
+    }
+
+    /* stream image */
+    size_t left = req->content_len, timeouts = 0;
+    while (ret == ESP_OK && left) {
+        int len = httpd_req_recv(
+            req, buf, (left < POOL_CHUNK_SIZE) ? left : POOL_CHUNK_SIZE
+        );
+        if (len == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < WEB_OTA_MAX_TIMEOUTS)
+            continue; // retry
+        if (len <= 0) {
+            ESP_LOGE(TAG, "cannot receive image (%d)", len);
+            ret = ESP_FAIL;
+            break;
+        }
+        timeouts = 0;
+        ret = ota_write(buf, len);
+        left -= len;
+    }
+
+    struct ota_report report;
+    if (ret == ESP_OK) ret = ota_end(&report);
+    else ota_abort();
+    if (ret != ESP_OK) {
+        pool_put(buf);
+        return httpd_resp_send_err(
+            req, HTTPD_500_INTERNAL_SERVER_ERROR, "update failed"
+        );
+    }
+
+    /* send report */
+    size_t len = snprintf(
+        buf, POOL_CHUNK_SIZE,
+        "{\"received\":%lu,\"written\":%lu,\"duration_ms\":%lu,"
+        "\"baseline\":{\"samples\":%lu,\"late\":%lu,\"max_jitter_us\":%lu},"
+        "\"during\":{\"samples\":%lu,\"late\":%lu,\"max_jitter_us\":%lu}}",
+        (unsigned long)report.received, (unsigned long)report.written,
+        (unsigned long)report.duration_ms,
+        (unsigned long)report.baseline.samples,
+        (unsigned long)report.baseline.late,
+        (unsigned long)report.baseline.max_jitter_us,
+        (unsigned long)report.during.samples,
+        (unsigned long)report.during.late,
+        (unsigned long)report.during.max_jitter_us
+    );
+    ret = httpd_resp_set_hdr(req, "Content-Type", "application/json");
+    if (ret == ESP_OK) ret = httpd_resp_send(req, buf, len);
+    pool_put(buf);
+
+    ESP_LOGI(TAG, "update finished - restarting");
+    vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY)); // let the response go out
+    esp_restart();
+    return ret;
 }
 
+static const httpd_uri_t web_post_ota = {
+    "/ota", HTTP_POST,
+    web_ota
+};
+
+/* all URI handlers */
+const httpd_uri_t *web_handlers[] = {
+    &web_get_index_htm, &web_get_root,
+    &web_get_alert_mp3, &web_get_plot_js,
+    &web_ws, &web_post_clear, &web_get_boot, &web_post_ota,
+#ifdef WEB_EMBED_CHARTJS
+    &web_get_chart_min_js,
+#endif
+#if TRACE_ENABLE
+    &web_get_trace, &web_post_trace_arm, &web_post_trace_freeze
+#endif
+};
+
 /*
  * static void web_event_task(void *parameter)
  *  Task function for the webserver's event handling functionality.
@@ -346,21 +1134,39 @@ static void web_wifi_event_handler(void *arg, esp_event_base_t event_base,
 static void web_event_task(void *parameter) {
     (void) parameter;
 
+    TickType_t last_metrics = xTaskGetTickCount();
+    pool_guard_begin(); // no heap allocations expected from here on
     while (true) {
         EventBits_t events = xEventGroupWaitBits(
-            se_events, SE_TEMP_UPDATE | SE_OCC_UPDATE | SE_HELP,
+            se_events, SE_TEMP_UPDATE | SE_OCC_UPDATE | SE_HELP | SE_SCOPE,
             pdTRUE, pdFALSE, // wait for any of the above events + clr on exit
-            portMAX_DELAY
+            pdMS_TO_TICKS(
+                (web_pending) ? WEB_PENDING_PERIOD : WEB_METRICS_PERIOD
+            ) // or until metrics or pending updates are due
         );
         if (events & SE_TEMP_UPDATE) { // temperature update
-            web_ws_send_all(web_ws_send_last_temp);   
+            web_ws_send_all(WEB_TOPIC_TEMP);
         }
         if (events & SE_OCC_UPDATE) { // occupancy update
-            web_ws_send_all(web_ws_send_occupancy);   
+            web_ws_send_all(WEB_TOPIC_OCC);
         }
         if (events & SE_HELP) { // help signalled
-            web_help = true;
-            web_ws_send_all(web_ws_send_help);
+            web_ws_send_all(WEB_TOPIC_HELP);
+        }
+        if (events & SE_SCOPE) { // scope batch ready
+            web_ws_send_all(WEB_TOPIC_FORCE);
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (now - last_metrics >= pdMS_TO_TICKS(WEB_METRICS_PERIOD)) {
+            last_metrics = now;
+            web_ws_send_all(WEB_TOPIC_METRICS);
+        }
+
+        if (web_pending) { // deliver rate limited updates that are due
+            pool_guard_end(); // NOTE: see web_ws_send_all()
+            httpd_queue_work(web_handle, web_ws_flush_pending, NULL);
+            pool_guard_begin();
         }
     }
 }
@@ -370,54 +1176,11 @@ static StaticTask_t web_task_buf; // TCB
 static StackType_t web_task_stack[STACK_SIZE];
 
 void web_init() {    
-    /* initialise NVS */
-    esp_err_t ret = nvs_flash_init();
-    if (
-            ret == ESP_ERR_NVS_NO_FREE_PAGES
-        ||  ret == ESP_ERR_NVS_NEW_VERSION_FOUND
-    ) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-
-    /* initialise networking */
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());    
-    esp_netif_create_default_wifi_sta();
-    
-    /* initialise WiFi */
-    wifi_init_config_t wifi_config = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&wifi_config));
-    esp_event_handler_instance_t instance_any_id;
-    ESP_ERROR_CHECK(
-        esp_event_handler_instance_register(
-            WIFI_EVENT, ESP_EVENT_ANY_ID, &web_wifi_event_handler,
-            NULL, &instance_any_id
-        )
-    );
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(
-        esp_event_handler_instance_register(
-            IP_EVENT, IP_EVENT_STA_GOT_IP, &web_wifi_event_handler,
-            NULL, &instance_got_ip
-        )
-    );
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-
-    wifi_config_t sta_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASSWORD,            
-            .threshold.authmode = WIFI_AUTH_WPA_WPA2_PSK,
-        }
-    };
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
-    
-    ESP_ERROR_CHECK(esp_wifi_start());
-
     httpd_config_t httpd_config = HTTPD_DEFAULT_CONFIG();
     httpd_config.lru_purge_enable = true;
+    httpd_config.max_open_sockets = WEB_MAX_CLIENTS;
+    httpd_config.close_fn = web_close_fn;
+    for (size_t i = 0; i < WEB_MAX_CLIENTS; i++) web_subs[i].fd = -1;
     httpd_config.max_uri_handlers = 
         sizeof(web_handlers) / sizeof(httpd_uri_t*);
     ESP_ERROR_CHECK(httpd_start(&web_handle, &httpd_config));
@@ -434,4 +1197,6 @@ void web_init() {
         web_event_task, TAG "_event", STACK_SIZE, NULL, MAX_PRIORITY - 2,
         web_task_stack, &web_task_buf
     );
+
+    boot_mark(BOOT_MARK_HTTPD);
 }
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "wifi_mgr.h"
+#include "boot.h"
+
+#include <esp_log.h>
+#include <esp_check.h>
+#include <esp_event.h>
+#include <esp_netif.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <nvs.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+
+#include <string.h>
+
+#define TAG                                 "wifi_mgr"
+
+static esp_netif_t *wm_netif;
+static wifi_config_t wm_config; // station configuration
+
+/* cached AP */
+static bool wm_cached = false; // set if wm_config holds a cached AP
+static bool wm_dirty = false; // set if wm_config is to be applied
+static size_t wm_fast_fails = 0; // consecutive failed fast connects
+static portMUX_TYPE wm_config_lock = portMUX_INITIALIZER_UNLOCKED;
+    // guards wm_config, wm_cached and wm_dirty once WiFi is started
+
+/*
+ * NOTE: the cached AP is updated by the event handler (in the system event
+ * task) and applied by wm_connect() (mostly in the timer task), so it is
+ * only accessed under wm_config_lock. NVS is updated from the timer task
+ * (see wm_persist()), as the system event task's stack is too small for it.
+ */
+
+/* reconnection backoff */
+static TimerHandle_t wm_timer;
+static StaticTimer_t wm_timer_buf;
+static size_t wm_retries = 0; // reconnections since last success
+static int64_t wm_attempt_start; // timestamp of current connection attempt
+
+static struct wm_stats wm_stats;
+static portMUX_TYPE wm_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * static void wm_load(nvs_handle_t nvs)
+ *  Loads the credentials and cached AP from NVS into wm_config.
+ *  Inputs:
+ *   - nvs : Handle to the WM_NVS_NAMESPACE namespace.
+ *  Output: None.
+ */
+static void wm_load(nvs_handle_t nvs) {
+    size_t len = sizeof(wm_config.sta.ssid);
+    if (nvs_get_str(nvs, "ssid", (char *)wm_config.sta.ssid, &len) == ESP_OK) {
+        len = sizeof(wm_config.sta.password);
+        if (nvs_get_str(
+            nvs, "password", (char *)wm_config.sta.password, &len
+        ) != ESP_OK) wm_config.sta.password[0] = '\0';
+        ESP_LOGI(TAG, "using credentials from NVS");
+    }
+
+    len = sizeof(wm_config.sta.bssid);
+    uint8_t channel;
+    if (
+            nvs_get_blob(nvs, "bssid", wm_config.sta.bssid, &len) == ESP_OK
+        &&  len == sizeof(wm_config.sta.bssid)
+        &&  nvs_get_u8(nvs, "channel", &channel) == ESP_OK
+    ) {
+        wm_config.sta.bssid_set = true;
+        wm_config.sta.channel = channel;
+        wm_cached = true;
+        ESP_LOGI(
+            TAG, "cached AP " MACSTR " on channel %u",
+            MAC2STR(wm_config.sta.bssid), channel
+        );
+    }
+}
+
+/*
+ * static void wm_persist(void *arg1, uint32_t arg2)
+ *  Writes the cached AP (or its absence) to NVS. This is executed in the
+ *  timer task (see xTimerPendFunctionCall()).
+ *  Inputs:
+ *   - arg1 : Ignored.
+ *   - arg2 : Ignored.
+ *  Output: None.
+ */
+static void wm_persist(void *arg1, uint32_t arg2) {
+    (void) arg1; (void) arg2;
+    uint8_t bssid[sizeof(wm_config.sta.bssid)];
+    taskENTER_CRITICAL(&wm_config_lock);
+    bool cached = wm_cached;
+    uint8_t channel = wm_config.sta.channel;
+    memcpy(bssid, wm_config.sta.bssid, sizeof(bssid));
+    taskEXIT_CRITICAL(&wm_config_lock);
+
+    nvs_handle_t nvs;
+    if (nvs_open(WM_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+    if (!cached) {
+        nvs_erase_key(nvs, "bssid");
+        nvs_erase_key(nvs, "channel");
+        nvs_commit(nvs);
+    } else if (
+            nvs_set_blob(nvs, "bssid", bssid, sizeof(bssid)) != ESP_OK
+        ||  nvs_set_u8(nvs, "channel", channel) != ESP_OK
+        ||  nvs_commit(nvs) != ESP_OK
+    ) ESP_LOGW(TAG, "cannot cache AP in NVS");
+    nvs_close(nvs);
+}
+
+/*
+ * static void wm_save(const uint8_t *bssid, uint8_t channel)
+ *  Caches the AP of a successful connection (if it has changed), to be
+ *  applied on the next connection and saved to NVS.
+ *  Inputs:
+ *   - bssid   : The AP's BSSID.
+ *   - channel : The AP's channel.
+ *  Output: None.
+ */
+static void wm_save(const uint8_t *bssid, uint8_t channel) {
+    taskENTER_CRITICAL(&wm_config_lock);
+    bool changed =
+            !wm_cached || wm_config.sta.channel != channel
+        ||  memcmp(wm_config.sta.bssid, bssid, sizeof(wm_config.sta.bssid));
+    if (changed) {
+        memcpy(wm_config.sta.bssid, bssid, sizeof(wm_config.sta.bssid));
+        wm_config.sta.channel = channel;
+        wm_config.sta.bssid_set = true;
+        wm_cached = true; wm_dirty = true; // applied on next connection
+    }
+    taskEXIT_CRITICAL(&wm_config_lock);
+
+    if (changed && xTimerPendFunctionCall(wm_persist, NULL, 0, 0) != pdPASS)
+        ESP_LOGW(TAG, "cannot cache AP in NVS");
+        // NOTE: unchanged APs are not rewritten, to spare the flash
+}
+
+/*
+ * static void wm_forget()
+ *  Forgets the cached AP, so that subsequent connections scan all channels.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void wm_forget() {
+    ESP_LOGW(TAG, "cached AP unreachable - falling back to full scan");
+    taskENTER_CRITICAL(&wm_config_lock);
+    wm_cached = false;
+    wm_config.sta.bssid_set = false;
+    wm_config.sta.channel = 0;
+    wm_dirty = true; // applied on next connection
+    taskEXIT_CRITICAL(&wm_config_lock);
+
+    if (xTimerPendFunctionCall(wm_persist, NULL, 0, 0) != pdPASS)
+        ESP_LOGW(TAG, "cannot remove cached AP from NVS");
+}
+
+/*
+ * static void wm_connect()
+ *  Starts a connection attempt.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void wm_connect() {
+    wifi_config_t config; // copy of wm_config (if it is to be applied)
+    taskENTER_CRITICAL(&wm_config_lock);
+    bool cached = wm_cached, dirty = wm_dirty;
+    if (dirty) config = wm_config;
+    wm_dirty = false;
+    taskEXIT_CRITICAL(&wm_config_lock);
+
+    wm_attempt_start = esp_timer_get_time();
+    taskENTER_CRITICAL(&wm_stats_lock);
+    wm_stats.attempts++;
+    wm_stats.fast = cached;
+    taskEXIT_CRITICAL(&wm_stats_lock);
+
+    ESP_LOGI(
+        TAG, "connecting to WiFi (%s)", (cached) ? "cached AP" : "scan"
+    );
+    if (dirty) ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &config));
+    esp_err_t ret = esp_wifi_connect();
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "cannot connect to WiFi (%s)", esp_err_to_name(ret));
+}
+
+/*
+ * static void wm_timer_callback(TimerHandle_t timer)
+ *  Callback function for the reconnection backoff timer.
+ *  Inputs:
+ *   - timer : The timer that triggered this callback.
+ *  Output: None.
+ */
+static void wm_timer_callback(TimerHandle_t timer) {
+    (void) timer;
+    wm_connect();
+}
+
+/*
+ * static void wm_reconnect()
+ *  Schedules a reconnection with jittered exponential backoff, i.e. after a
+ *  random delay between half and all of min(WM_BACKOFF_MIN * 2^retries,
+ *  WM_BACKOFF_MAX), so that units losing their connection at the same time
+ *  do not retry in lockstep.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void wm_reconnect() {
+    uint32_t cap = WM_BACKOFF_MAX;
+    if (wm_retries < 16 && (WM_BACKOFF_MIN << wm_retries) < WM_BACKOFF_MAX)
+        cap = WM_BACKOFF_MIN << wm_retries;
+    uint32_t delay = cap / 2 + esp_random() % (cap / 2 + 1);
+    wm_retries++;
+
+    ESP_LOGI(TAG, "reconnecting in %lu ms", (unsigned long)delay);
+    TickType_t ticks = pdMS_TO_TICKS(delay);
+    xTimerChangePeriod(wm_timer, (ticks) ? ticks : 1, portMAX_DELAY);
+        // also starts the timer
+}
+
+/*
+ * static void wm_event_handler(void *arg, esp_event_base_t event_base,
+ *                              int32_t event_id, void *event_data)
+ *  Handler for networking (WiFi/IP stack) events, including WiFi station
+ *  starts, connections, disconnections, and IP address acquisition.
+ *  Inputs:
+ *   - arg        : Arbitrary argument passed from ESP-IDF; ignored.
+ *   - event_base : The event's source (WiFi or IP stack).
+ *   - event_id   : The event's identifier.
+ *   - event_data : Arbitrary data supplied along with the event.
+ *  Output: None.
+ */
+static void wm_event_handler(void *arg, esp_event_base_t event_base,
+                             int32_t event_id, void *event_data) {
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        wm_connect(); // first attempt goes out immediately
+    }
+    else if (
+        event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED
+    ) {
+        wifi_event_sta_connected_t *event =
+            (wifi_event_sta_connected_t *)event_data;
+        ESP_LOGI(
+            TAG, "associated with " MACSTR " on channel %u",
+            MAC2STR(event->bssid), event->channel
+        );
+        wm_fast_fails = 0;
+        wm_save(event->bssid, event->channel);
+    }
+    else if (
+        event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED
+    ) {
+        wifi_event_sta_disconnected_t *event =
+            (wifi_event_sta_disconnected_t *)event_data;
+        ESP_LOGW(TAG, "disconnected from WiFi (reason %u)", event->reason);
+
+        taskENTER_CRITICAL(&wm_stats_lock);
+        if (wm_stats.connected) wm_stats.disconnects++;
+        wm_stats.connected = false;
+        wm_stats.last_reason = event->reason;
+        taskEXIT_CRITICAL(&wm_stats_lock);
+
+        if (wm_cached && ++wm_fast_fails >= WM_FAST_FAILS) {
+            // NOTE: read without the lock, as only this task writes it
+            wm_fast_fails = 0;
+            wm_forget();
+        }
+        wm_reconnect();
+    }
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        int64_t now = esp_timer_get_time();
+
+        taskENTER_CRITICAL(&wm_stats_lock);
+        wm_stats.connected = true;
+        wm_stats.connects++;
+        wm_stats.last_connect_ms = (now - wm_attempt_start) / 1000;
+        if (!wm_stats.first_ip_us) wm_stats.first_ip_us = now;
+        taskEXIT_CRITICAL(&wm_stats_lock);
+        wm_retries = 0;
+        boot_mark(BOOT_MARK_IP);
+
+        ESP_LOGI(
+            TAG, "IP address: " IPSTR " (connected in %lu ms)",
+            IP2STR(&event->ip_info.ip),
+            (unsigned long)wm_stats.last_connect_ms
+        );
+    }
+}
+
+void wm_init() {
+    wm_netif = esp_netif_create_default_wifi_sta();
+
+#ifdef WM_STATIC_IP
+    /* use static IP instead of DHCP */
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(wm_netif));
+    esp_netif_ip_info_t ip_info;
+    ip_info.ip.addr = esp_ip4addr_aton(WM_STATIC_IP);
+    ip_info.netmask.addr = esp_ip4addr_aton(WM_STATIC_NETMASK);
+    ip_info.gw.addr = esp_ip4addr_aton(WM_STATIC_GW);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(wm_netif, &ip_info));
+    esp_netif_dns_info_t dns_info = { 0 };
+    dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+    dns_info.ip.u_addr.ip4.addr = esp_ip4addr_aton(WM_STATIC_DNS);
+    ESP_ERROR_CHECK(
+        esp_netif_set_dns_info(wm_netif, ESP_NETIF_DNS_MAIN, &dns_info)
+    );
+#endif
+
+    /* configure reconnection timer */
+    wm_timer = xTimerCreateStatic(
+        "wifi_backoff", pdMS_TO_TICKS(WM_BACKOFF_MIN), pdFALSE, NULL,
+        wm_timer_callback, &wm_timer_buf
+    );
+    assert(wm_timer);
+
+    /* initialise WiFi */
+    wifi_init_config_t wifi_config = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+        // we manage our own cache in NVS
+    esp_event_handler_instance_t instance_any_id;
+    ESP_ERROR_CHECK(
+        esp_event_handler_instance_register(
+            WIFI_EVENT, ESP_EVENT_ANY_ID, &wm_event_handler,
+            NULL, &instance_any_id
+        )
+    );
+    esp_event_handler_instance_t instance_got_ip;
+    ESP_ERROR_CHECK(
+        esp_event_handler_instance_register(
+            IP_EVENT, IP_EVENT_STA_GOT_IP, &wm_event_handler,
+            NULL, &instance_got_ip
+        )
+    );
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+
+    memset(&wm_config, 0, sizeof(wifi_config_t));
+    strncpy(
+        (char *)wm_config.sta.ssid, WIFI_SSID, sizeof(wm_config.sta.ssid)
+    );
+    strncpy(
+        (char *)wm_config.sta.password, WIFI_PASSWORD,
+        sizeof(wm_config.sta.password)
+    );
+    wm_config.sta.threshold.authmode = WIFI_AUTH_WPA_WPA2_PSK;
+    wm_config.sta.scan_method = WIFI_FAST_SCAN;
+    wm_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+
+    nvs_handle_t nvs;
+    if (nvs_open(WM_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        wm_load(nvs);
+        nvs_close(nvs);
+    }
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wm_config));
+
+    ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+void wm_get_stats(struct wm_stats *stats) {
+    taskENTER_CRITICAL(&wm_stats_lock);
+    *stats = wm_stats;
+    taskEXIT_CRITICAL(&wm_stats_lock);
+}
@@ -0,0 +1,642 @@
+/*
+ * bedsim - host stand-in for a bed monitor unit's web server.
+ * Usage: bedsim [-p port] [-a assets] [-n clients] [-t temp_ms]
+ *  -p : Port to listen on (default 8080).
+ *  -a : Directory holding index.htm, plot.js, alert.mp3 and (if built
+ *       with WEB_EMBED_CHARTJS) chart.umd.min.js (default: the firmware's
+ *       assets).
+ *  -n : Max concurrent connections, beyond which the least recently active
+ *       one is dropped like httpd's LRU purge (default WEB_MAX_CLIENTS).
+ *  -t : Temperature update period in ms (default 5000).
+ * Serves the same endpoints and WebSocket protocol as the firmware (static
+ * files, /ws with subscriptions, /clear and /boot) with synthetic sensor
+ * data, so that the dashboard and the protocol handling of tools/wsbench
+ * and tools/guardcheck can be exercised without hardware. Like the
+ * firmware, it only serves Chart.js (and makes the dashboard load it) if
+ * built with WEB_EMBED_CHARTJS. The temperature history is kept in a
+ * tscomp store, as on the unit. Like the unit's httpd, it serves everything
+ * from a single thread.
+ * NOTE: This is a separate implementation of the protocol and shares no
+ * code with webserver.c, so load and latency figures measured against it
+ * describe bedsim and the host, not the unit; capacity numbers only count
+ * when taken against real hardware.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE // for memmem()
+
+#include "ws.h"
+#include "tscomp.h"
+#include "webserver.h"
+#include "thermistor.h"
+#include "fsr.h"
+
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define MAX_CONNS                   256 // hard connection limit
+#define HEAD_MAX                    2048 // max request head length
+#define OCC_PERIOD                  60000 // occupancy toggle period (ms)
+
+/* static file */
+struct file {
+    const char *uri; // request path
+    const char *name; // file name in assets directory
+    const char *mime; // MIME type
+    char *data; // contents
+    size_t len; // length of contents
+};
+
+static struct file files[] = {
+    { "/", "index.htm", "text/html", NULL, 0 },
+    { "/index.htm", "index.htm", "text/html", NULL, 0 },
+    { "/plot.js", "plot.js", "application/javascript", NULL, 0 },
+#ifdef WEB_EMBED_CHARTJS
+    { "/chart.umd.min.js", "chart.umd.min.js", "application/javascript",
+      NULL, 0 },
+#endif
+    { "/alert.mp3", "alert.mp3", "audio/mpeg", NULL, 0 }
+};
+#define NUM_FILES                   (sizeof(files) / sizeof(struct file))
+
+/* client connection */
+struct client {
+    struct ws_conn ws; // connection (ws.fd < 0 if slot is unused)
+    bool upgraded; // set once upgraded to WebSocket
+    uint8_t topics; // subscribed topics (1 << WEB_TOPIC_x)
+    uint32_t interval; // min interval between stream updates (ms)
+    double last_sent[WEB_NUM_TOPICS]; // last stream update timestamps (ms)
+    uint8_t pending; // stream topics with a rate limited update to deliver
+    double last_active; // last activity timestamp (ms) - for LRU purging
+};
+
+static struct client clients[MAX_CONNS];
+static size_t max_clients = WEB_MAX_CLIENTS;
+
+static const char topic_chars[WEB_NUM_TOPICS] = { 't', 'o', 'h', 'f', 'm' };
+
+/* simulated unit state */
+static struct ts_block history_blocks[RT_HISTORY_SIZE / TS_BLOCK_SIZE];
+static struct ts_store history;
+static float temp = 36.5f;
+static bool occupancy = false, help = false;
+static uint32_t scope_seq = 0;
+static double start;
+
+/*
+ * static char *load_file(const char *path, size_t *len)
+ *  Loads a file into memory.
+ *  Inputs:
+ *   - path : Path to the file.
+ *   - len  : Pointer to the output length.
+ *  Output: Pointer to the (heap allocated) contents, or NULL on failure.
+ */
+static char *load_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    char *data = malloc(*len);
+    if (data && fread(data, 1, *len, fp) != *len) {
+        free(data); data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+#ifdef WEB_EMBED_CHARTJS
+/*
+ * static char *embed_chartjs(char *html, size_t *len)
+ *  Makes a dashboard page load Chart.js by replacing its placeholder
+ *  (WEB_CHARTJS_MARKER) with the script tag, as firmware builds embedding
+ *  Chart.js do.
+ *  Inputs:
+ *   - html : The (heap allocated) page, which this takes over.
+ *   - len  : Pointer to the page length, which is updated.
+ *  Output: Pointer to the (heap allocated) new page, or NULL on failure.
+ */
+static char *embed_chartjs(char *html, size_t *len) {
+    static const char marker[] = WEB_CHARTJS_MARKER;
+    static const char script[] = WEB_CHARTJS_SCRIPT;
+    char *pos = memmem(html, *len, marker, sizeof(marker) - 1);
+    if (!pos) return html;
+
+    size_t head = pos - html, tail = *len - head - (sizeof(marker) - 1);
+    char *page = malloc(head + sizeof(script) - 1 + tail);
+    if (page) {
+        memcpy(page, html, head);
+        memcpy(page + head, script, sizeof(script) - 1);
+        memcpy(page + head + sizeof(script) - 1, pos + sizeof(marker) - 1,
+               tail);
+        *len = head + sizeof(script) - 1 + tail;
+    }
+    free(html);
+    return page;
+}
+#endif
+
+/*
+ * static void send_all(int fd, const void *data, size_t len)
+ *  Sends data over a (blocking) socket in its entirety.
+ *  Inputs:
+ *   - fd   : The socket.
+ *   - data : The data.
+ *   - len  : The data length.
+ *  Output: None.
+ */
+static void send_all(int fd, const void *data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t ret = send(
+            fd, (const char *)data + sent, len - sent, MSG_NOSIGNAL
+        );
+        if (ret <= 0) return;
+        sent += ret;
+    }
+}
+
+/*
+ * static void send_response(int fd, const char *status, const char *mime,
+ *                           const void *body, size_t len)
+ *  Sends an HTTP response (with the connection to be closed afterwards).
+ *  Inputs:
+ *   - fd     : The socket.
+ *   - status : The status line (e.g. "200 OK").
+ *   - mime   : The content type (NULL if none).
+ *   - body   : The response body.
+ *   - len    : The response body's length.
+ *  Output: None.
+ */
+static void send_response(int fd, const char *status, const char *mime,
+                          const void *body, size_t len) {
+    char head[256];
+    int head_len = snprintf(
+        head, sizeof(head),
+        "HTTP/1.1 %s\r\n%s%s%sContent-Length: %zu\r\n"
+        "Connection: close\r\n\r\n",
+        status, (mime) ? "Content-Type: " : "", (mime) ? mime : "",
+        (mime) ? "\r\n" : "", len
+    );
+    send_all(fd, head, head_len);
+    send_all(fd, body, len);
+}
+
+/*
+ * static void ws_text(struct client *client, const char *fmt, ...)
+ *  Formats and sends a text message to a WebSocket client.
+ *  Inputs:
+ *   - client : The client.
+ *   - fmt    : The message's format string, followed by its arguments.
+ *  Output: None.
+ */
+static void ws_text(struct client *client, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+static void ws_text(struct client *client, const char *fmt, ...) {
+    char buf[256];
+    va_list args; va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    ws_send(&client->ws, WS_OP_TEXT, buf, len);
+}
+
+/*
+ * static void ws_update(struct client *client, enum web_topic topic,
+ *                       float value)
+ *  Sends a t:, o: or h: update message (see web_format_update()) to a
+ *  WebSocket client.
+ *  Inputs:
+ *   - client : The client.
+ *   - topic  : The message's topic.
+ *   - value  : The temperature or status.
+ *  Output: None.
+ */
+static void ws_update(struct client *client, enum web_topic topic,
+                      float value) {
+    char buf[WEB_UPDATE_MAX_LEN];
+    size_t len = web_format_update(buf, sizeof(buf), topic, value);
+    ws_send(&client->ws, WS_OP_TEXT, buf, len);
+}
+
+/*
+ * static void send_history(struct client *client)
+ *  Sends the temperature history (T: message) to a client in fragments of
+ *  WEB_TEMPS_CHUNK entries, like the unit does.
+ *  Inputs:
+ *   - client : The client.
+ *  Output: None.
+ */
+static void send_history(struct client *client) {
+    char buf[2 + TS_FORMAT_MAX_LEN * WEB_TEMPS_CHUNK + 1];
+    size_t len = 2;
+    bool first = true, final = false;
+    uint8_t opcode = WS_OP_TEXT;
+    buf[0] = 'T'; buf[1] = ':';
+
+    struct ts_iter it; ts_iter_init(&it, &history);
+    if (history.count > RT_HISTORY_LEN)
+        ts_iter_skip(&it, history.count - RT_HISTORY_LEN);
+    while (!final) {
+        size_t chunk;
+        len += ts_format(&it, &buf[len], WEB_TEMPS_CHUNK, !first, &chunk);
+        if (chunk) first = false;
+        final = chunk < WEB_TEMPS_CHUNK;
+
+        /* send fragment (manually, as ws_send() does not fragment) */
+        uint8_t head[4] = { opcode | ((final) ? 0x80 : 0) };
+        size_t head_len = 2;
+        if (len < 126) head[1] = len;
+        else {
+            head[1] = 126; head[2] = len >> 8; head[3] = len;
+            head_len = 4;
+        }
+        send_all(client->ws.fd, head, head_len);
+        send_all(client->ws.fd, buf, len);
+        opcode = WS_OP_CONT; len = 0;
+    }
+}
+
+/*
+ * static void send_scope(struct client *client)
+ *  Sends a synthetic scope frame (same layout as the unit's) to a client.
+ *  Inputs:
+ *   - client : The client.
+ *  Output: None.
+ */
+static void send_scope(struct client *client) {
+    uint8_t frame[16 + 4 * FSR_SCOPE_BATCH] = {
+        'f', 1, FSR_SCOPE_BATCH, 0,
+        scope_seq, scope_seq >> 8, scope_seq >> 16, scope_seq >> 24,
+        0, 0, 0, 0,
+        FSR_INTERVAL, 0, 0, 0
+    };
+    for (size_t i = 0; i < FSR_SCOPE_BATCH; i++) {
+        uint16_t force = (occupancy) ? 2000 + rand() % 200 : rand() % 20;
+        uint16_t mv = force / 2;
+        uint8_t *p = &frame[16 + 4 * i];
+        p[0] = force; p[1] = force >> 8; p[2] = mv; p[3] = mv >> 8;
+    }
+    ws_send(&client->ws, WS_OP_BINARY, frame, sizeof(frame));
+}
+
+/*
+ * static void send_topic(struct client *client, enum web_topic topic)
+ *  Sends a topic's current value to a client.
+ *  Inputs:
+ *   - client : The client.
+ *   - topic  : The topic.
+ *  Output: None.
+ */
+static void send_topic(struct client *client, enum web_topic topic) {
+    double now = now_ms();
+    client->last_sent[topic] = now;
+    client->pending &= ~(1 << topic);
+
+    switch (topic) {
+        case WEB_TOPIC_TEMP: ws_update(client, topic, temp); break;
+        case WEB_TOPIC_OCC: ws_update(client, topic, occupancy); break;
+        case WEB_TOPIC_HELP: ws_update(client, topic, help); break;
+        case WEB_TOPIC_FORCE: send_scope(client); break;
+        case WEB_TOPIC_METRICS: {
+            size_t num_clients = 0;
+            for (size_t i = 0; i < max_clients; i++) {
+                if (clients[i].ws.fd >= 0 && clients[i].upgraded)
+                    num_clients++;
+            }
+            ws_text(
+                client, "m:%lu,%u,%u,%zu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
+                (unsigned long)((now - start) / 1000), 120000, 100000,
+                num_clients, 1500, 2000, 1, 60000, 0, 1, 1, 0, 0, 0
+            );
+            break;
+        }
+        default: break;
+    }
+}
+
+/*
+ * static void broadcast(enum web_topic topic, bool stream)
+ *  Sends a topic update to all subscribed clients, applying rate limits to
+ *  stream topics. Like the unit, the latest value is delivered once a
+ *  client's interval ends (see flush_pending()), except for scope frames.
+ *  Inputs:
+ *   - topic  : The topic.
+ *   - stream : Whether the topic is rate limited.
+ *  Output: None.
+ */
+static void broadcast(enum web_topic topic, bool stream) {
+    double now = now_ms();
+    for (size_t i = 0; i < max_clients; i++) {
+        struct client *client = &clients[i];
+        if (client->ws.fd < 0 || !client->upgraded) continue;
+        if (!(client->topics & (1 << topic))) continue;
+        if (stream && now - client->last_sent[topic] < client->interval) {
+            if (topic != WEB_TOPIC_FORCE) client->pending |= 1 << topic;
+            continue;
+        }
+        send_topic(client, topic);
+    }
+}
+
+/*
+ * static void flush_pending()
+ *  Delivers rate limited updates to the clients whose interval has since
+ *  elapsed.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void flush_pending() {
+    double now = now_ms();
+    for (size_t i = 0; i < max_clients; i++) {
+        struct client *client = &clients[i];
+        if (client->ws.fd < 0 || !client->pending) continue;
+        for (size_t topic = 0; topic < WEB_NUM_TOPICS; topic++) {
+            if (!(client->pending & (1 << topic))) continue;
+            if (now - client->last_sent[topic] >= client->interval)
+                send_topic(client, topic);
+        }
+    }
+}
+
+/*
+ * static void handle_message(struct client *client, const char *msg)
+ *  Handles a subscription message from a client (same syntax as the unit).
+ *  Inputs:
+ *   - client : The client.
+ *   - msg    : The null-terminated message.
+ *  Output: None.
+ */
+static void handle_message(struct client *client, const char *msg) {
+    uint8_t topics = 0; uint32_t interval = 0;
+    if (!msg[0]) topics = WEB_DEFAULT_TOPICS;
+    else if (msg[0] == 's' && msg[1] == ':') {
+        for (msg += 2; *msg && *msg != ','; msg++) {
+            const char *topic = memchr(topic_chars, *msg, WEB_NUM_TOPICS);
+            if (!topic) return; // invalid - ignored
+            topics |= 1 << (topic - topic_chars);
+        }
+        if (*msg == ',') interval = strtoul(msg + 1, NULL, 10);
+    } else return;
+
+    client->topics = topics; client->interval = interval;
+    client->pending &= topics;
+    if (topics & (1 << WEB_TOPIC_TEMP)) send_history(client);
+    if (topics & (1 << WEB_TOPIC_OCC))
+        ws_update(client, WEB_TOPIC_OCC, occupancy);
+    if (topics & (1 << WEB_TOPIC_HELP))
+        ws_update(client, WEB_TOPIC_HELP, help);
+}
+
+/*
+ * static void handle_request(struct client *client)
+ *  Reads and handles an HTTP request from a new connection.
+ *  Inputs:
+ *   - client : The client.
+ *  Output: None.
+ */
+static void handle_request(struct client *client) {
+    int fd = client->ws.fd;
+    char head[HEAD_MAX];
+    if (http_read_head(fd, head, sizeof(head)) < 0) {
+        ws_conn_close(&client->ws);
+        return;
+    }
+
+    char method[8], uri[256];
+    if (sscanf(head, "%7s %255s", method, uri) != 2) {
+        ws_conn_close(&client->ws);
+        return;
+    }
+
+    size_t key_len;
+    const char *key = http_header(head, "Sec-WebSocket-Key", &key_len);
+    if (!strcmp(method, "GET") && !strcmp(uri, "/ws") && key) { // upgrade
+        char accept[29], resp[256];
+        ws_accept_key(key, key_len, accept);
+        int len = snprintf(
+            resp, sizeof(resp),
+            "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+            "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept
+        );
+        send_all(fd, resp, len);
+        client->upgraded = true;
+        client->topics = WEB_DEFAULT_TOPICS; client->interval = 0;
+        return;
+    }
+
+    if (!strcmp(method, "GET")) {
+        for (size_t i = 0; i < NUM_FILES; i++) {
+            if (strcmp(uri, files[i].uri)) continue;
+            send_response(fd, "200 OK", files[i].mime, files[i].data,
+                          files[i].len);
+            ws_conn_close(&client->ws);
+            return;
+        }
+        if (!strcmp(uri, "/boot")) {
+            static const char report[] =
+                "{\"reset_reason\":1,\"stages\":[],\"marks\":{},"
+                "\"serving\":0}";
+            send_response(fd, "200 OK", "application/json", report,
+                          sizeof(report) - 1);
+            ws_conn_close(&client->ws);
+            return;
+        }
+    } else if (!strcmp(method, "POST") && !strcmp(uri, "/clear")) {
+        help = false;
+        send_response(fd, "200 OK", NULL, "", 0);
+        ws_conn_close(&client->ws);
+        broadcast(WEB_TOPIC_HELP, false);
+        return;
+    }
+
+    send_response(fd, "404 Not Found", "text/plain", "Not found", 9);
+    ws_conn_close(&client->ws);
+}
+
+/*
+ * static void handle_ws(struct client *client)
+ *  Reads and handles WebSocket frames from a client.
+ *  Inputs:
+ *   - client : The client.
+ *  Output: None.
+ */
+static void handle_ws(struct client *client) {
+    if (ws_fill(&client->ws, 0) < 0) {
+        ws_conn_close(&client->ws);
+        return;
+    }
+
+    struct ws_frame msg;
+    int ret;
+    while ((ret = ws_next(&client->ws, &msg)) > 0) {
+        switch (msg.opcode) {
+            case WS_OP_TEXT:
+                if (msg.len <= WEB_WS_MAX_MSG)
+                    handle_message(client, (const char *)msg.payload);
+                break;
+            case WS_OP_PING:
+                ws_send(&client->ws, WS_OP_PONG, msg.payload, msg.len);
+                break;
+            case WS_OP_CLOSE:
+                ws_send(&client->ws, WS_OP_CLOSE, NULL, 0);
+                ws_conn_close(&client->ws);
+                return;
+            default:
+                break;
+        }
+    }
+    if (ret < 0) ws_conn_close(&client->ws);
+}
+
+/*
+ * static void accept_client(int listener)
+ *  Accepts a new connection, purging the least recently active one if all
+ *  slots are taken.
+ *  Inputs:
+ *   - listener : The listening socket.
+ *  Output: None.
+ */
+static void accept_client(int listener) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) return;
+    struct timeval timeout = { 1, 0 }; // for http_read_head
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct client *slot = NULL, *lru = NULL;
+    for (size_t i = 0; i < max_clients; i++) {
+        if (clients[i].ws.fd < 0) {
+            slot = &clients[i];
+            break;
+        }
+        if (!lru || clients[i].last_active < lru->last_active)
+            lru = &clients[i];
+    }
+    if (!slot) { // purge LRU connection
+        ws_conn_close(&lru->ws);
+        slot = lru;
+    }
+
+    memset(slot, 0, sizeof(struct client));
+    ws_conn_init(&slot->ws, fd, false);
+    slot->last_active = now_ms();
+}
+
+int main(int argc, char **argv) {
+    const char *port = "8080", *assets = FW_DIR "/assets";
+    double temp_period = 5000;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:a:n:t:")) != -1) {
+        switch (opt) {
+            case 'p': port = optarg; break;
+            case 'a': assets = optarg; break;
+            case 'n': max_clients = strtoul(optarg, NULL, 10); break;
+            case 't': temp_period = strtod(optarg, NULL); break;
+            default:
+                fprintf(
+                    stderr, "usage: %s [-p port] [-a assets] [-n clients] "
+                    "[-t temp_ms]\n", argv[0]
+                );
+                return 1;
+        }
+    }
+    if (!max_clients || max_clients > MAX_CONNS) max_clients = MAX_CONNS;
+
+    for (size_t i = 0; i < NUM_FILES; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", assets, files[i].name);
+        files[i].data = load_file(path, &files[i].len);
+#ifdef WEB_EMBED_CHARTJS
+        if (files[i].data && !strcmp(files[i].name, "index.htm"))
+            files[i].data = embed_chartjs(files[i].data, &files[i].len);
+#endif
+        if (!files[i].data) {
+            fprintf(stderr, "cannot load %s\n", path);
+            return 1;
+        }
+    }
+
+    int listener = tcp_listen(port);
+    if (listener < 0) {
+        perror("cannot listen");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    for (size_t i = 0; i < MAX_CONNS; i++) ws_conn_init(&clients[i].ws, -1, 0);
+
+    /* seed history with a full window of samples */
+    ts_init(&history, history_blocks, sizeof(history_blocks) /
+            sizeof(struct ts_block));
+    for (size_t i = 0; i < RT_HISTORY_LEN; i++)
+        ts_append(&history, 36.5f + 0.5f * sinf(i * 0.02f));
+
+    start = now_ms();
+    double next_temp = start + temp_period, next_occ = start + OCC_PERIOD;
+    double next_scope = start + FSR_INTERVAL * FSR_SCOPE_BATCH;
+    double next_metrics = start + WEB_METRICS_PERIOD;
+    fprintf(stderr, "listening on port %s\n", port);
+
+    while (true) {
+        struct pollfd pfds[MAX_CONNS + 1];
+        struct client *owners[MAX_CONNS + 1];
+        size_t n = 0;
+        pfds[n] = (struct pollfd){ listener, POLLIN, 0 }; owners[n++] = NULL;
+        for (size_t i = 0; i < max_clients; i++) {
+            if (clients[i].ws.fd < 0) continue;
+            pfds[n] = (struct pollfd){ clients[i].ws.fd, POLLIN, 0 };
+            owners[n++] = &clients[i];
+        }
+
+        double now = now_ms();
+        double next = next_scope;
+        if (next_temp < next) next = next_temp;
+        if (next_occ < next) next = next_occ;
+        if (next_metrics < next) next = next_metrics;
+        int timeout = (next > now) ? (int)(next - now) + 1 : 0;
+        if (poll(pfds, n, timeout) < 0) continue;
+
+        for (size_t i = 0; i < n; i++) {
+            if (!pfds[i].revents) continue;
+            if (!owners[i]) {
+                accept_client(listener);
+                continue;
+            }
+            struct client *client = owners[i];
+            client->last_active = now_ms();
+            if (client->upgraded) handle_ws(client);
+            else handle_request(client);
+        }
+
+        now = now_ms();
+        if (now >= next_scope) {
+            next_scope += FSR_INTERVAL * FSR_SCOPE_BATCH;
+            broadcast(WEB_TOPIC_FORCE, true);
+            scope_seq += FSR_SCOPE_BATCH;
+        }
+        if (now >= next_temp) {
+            next_temp += temp_period;
+            temp = 36.5f + 0.5f * sinf((now - start) * 1e-5f)
+                 + (rand() % 10) * 0.01f;
+            ts_append(&history, temp);
+            broadcast(WEB_TOPIC_TEMP, true);
+        }
+        if (now >= next_occ) {
+            next_occ += OCC_PERIOD;
+            occupancy = !occupancy;
+            broadcast(WEB_TOPIC_OCC, false);
+        }
+        if (now >= next_metrics) {
+            next_metrics += WEB_METRICS_PERIOD;
+            broadcast(WEB_TOPIC_METRICS, true);
+        }
+        flush_pending(); // NOTE: scope batches wake the loop often enough
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * bench - host runner for the firmware's portable microbenchmarks
+ * (main/src/bench_cases.c).
+ * Usage: bench [filter]
+ *  filter : Only run cases whose names contain this string.
+ * Prints one JSON line per case (see bench.h), to be compared against a
+ * baseline with benchcmp. Build with optimisations (the default build type
+ * for the tools is Release) for meaningful numbers.
+ * The whole suite is run ROUNDS times and the fastest time of each case is
+ * reported, so that a spell of host load (which may last longer than all
+ * BENCH_REPEATS runs of a case) only affects some of a case's runs.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS                      10 // suite runs (fastest is reported)
+#define ITERS_SCALE                 10 // iteration multiplier for the host
+    // NOTE: the cases' iteration counts are sized for the target, and runs
+    // this much shorter on the host would be dominated by timing noise
+
+static double best_ns[64]; // fastest time per iteration of each case (ns)
+static size_t current; // index of the case being run
+
+uint32_t bench_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+void bench_report(const char *name, uint32_t iters, uint32_t ticks) {
+    (void) name;
+    double ns = (double)ticks / iters;
+    if (!best_ns[current] || ns < best_ns[current]) best_ns[current] = ns;
+}
+
+int main(int argc, char **argv) {
+    const char *filter = (argc > 1) ? argv[1] : NULL;
+    if (bench_num_portable_cases > sizeof(best_ns) / sizeof(double)) {
+        fprintf(stderr, "too many benchmark cases\n");
+        return 1;
+    }
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        for (current = 0; current < bench_num_portable_cases; current++) {
+            struct bench_case scaled = bench_portable_cases[current];
+            if (filter && !strstr(scaled.name, filter)) continue;
+            scaled.iters *= ITERS_SCALE;
+            bench_run_cases(&scaled, 1);
+        }
+    }
+
+    for (size_t i = 0; i < bench_num_portable_cases; i++) {
+        if (!best_ns[i]) continue; // filtered out
+        printf(
+            "{\"bench\":\"%s\",\"platform\":\"host\",\"iters\":%u,"
+            "\"ns\":%.1f}\n", bench_portable_cases[i].name,
+            bench_portable_cases[i].iters * ITERS_SCALE, best_ns[i]
+        );
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * benchcmp - compares benchmark results against a baseline and flags
+ * regressions.
+ * Usage: benchcmp [-t percent] baseline current
+ *  -t       : Slowdown (%) beyond which a case is flagged (default 10).
+ *  baseline : Baseline results.
+ *  current  : Results to be checked.
+ * Both files hold the JSON lines printed by the benchmarks (see bench.h);
+ * any other lines (e.g. the rest of a serial console log) are ignored, so a
+ * captured target log can be passed as is. Results are matched by case name
+ * and platform, and compared by time per iteration relative to the
+ * BENCH_CALIBRATION case of the same file and platform, so that a baseline
+ * taken on one machine holds on another (and host timing noise that slows
+ * everything alike cancels out).
+ * Exits with status 1 if any case regressed, or if the current results are
+ * empty or do not cover every baseline case of their platforms (or the
+ * other way round), and with status 2 on usage or input errors.
+ */
+
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RESULTS                 256 // max results per file
+#define MAX_NAME                    64 // max case/platform name length
+
+/* benchmark result */
+struct result {
+    char name[MAX_NAME]; // case name
+    char platform[MAX_NAME]; // platform name
+    double ns; // time per iteration (ns)
+    double rel; // time per iteration relative to BENCH_CALIBRATION
+    bool matched; // set once matched with a result of the other file
+};
+
+/*
+ * static bool get_string(const char *line, const char *key, char *out)
+ *  Extracts a string field from a JSON line.
+ *  Inputs:
+ *   - line : The line.
+ *   - key  : The field name.
+ *   - out  : The output buffer (MAX_NAME bytes).
+ *  Output: Whether the field was found.
+ */
+static bool get_string(const char *line, const char *key, char *out) {
+    char pattern[MAX_NAME + 4];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *start = strstr(line, pattern);
+    if (!start) return false;
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (!end || end - start >= MAX_NAME) return false;
+    memcpy(out, start, end - start); out[end - start] = '\0';
+    return true;
+}
+
+/*
+ * static size_t load(const char *path, struct result *results)
+ *  Loads benchmark results from a file, exiting on failure.
+ *  Inputs:
+ *   - path    : The file's path.
+ *   - results : The output array (MAX_RESULTS entries).
+ *  Output: The number of results loaded.
+ */
+static size_t load(const char *path, struct result *results) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(2);
+    }
+
+    size_t count = 0;
+    char line[512];
+    while (count < MAX_RESULTS && fgets(line, sizeof(line), file)) {
+        const char *json = strstr(line, "{\"bench\":");
+        if (!json) continue;
+        struct result *result = &results[count];
+        const char *ns = strstr(json, "\"ns\":");
+        if (
+                !ns
+            ||  !get_string(json, "bench", result->name)
+            ||  !get_string(json, "platform", result->platform)
+        ) continue;
+        result->ns = strtod(ns + 5, NULL);
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+/*
+ * static void calibrate(const char *path, struct result *results,
+ *                       size_t count)
+ *  Computes the relative times of loaded results, exiting if a platform
+ *  lacks the calibration case.
+ *  Inputs:
+ *   - path    : The results' file path (for reporting).
+ *   - results : The results.
+ *   - count   : The number of results.
+ *  Output: None.
+ */
+static void calibrate(const char *path, struct result *results,
+                      size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const struct result *ref = NULL;
+        for (size_t j = 0; j < count && !ref; j++) {
+            if (
+                    !strcmp(results[j].name, BENCH_CALIBRATION)
+                &&  !strcmp(results[j].platform, results[i].platform)
+                &&  results[j].ns > 0
+            ) ref = &results[j];
+        }
+        if (!ref) {
+            fprintf(
+                stderr, "%s: no %s case for platform %s\n",
+                path, BENCH_CALIBRATION, results[i].platform
+            );
+            exit(2);
+        }
+        results[i].rel = results[i].ns / ref->ns;
+    }
+}
+
+/*
+ * static bool has_platform(const struct result *results, size_t count,
+ *                          const char *platform)
+ *  Checks whether any result is for a platform.
+ *  Inputs:
+ *   - results  : The results.
+ *   - count    : The number of results.
+ *   - platform : The platform name.
+ *  Output: Whether a result for the platform was found.
+ */
+static bool has_platform(const struct result *results, size_t count,
+                         const char *platform) {
+    for (size_t i = 0; i < count; i++) {
+        if (!strcmp(results[i].platform, platform)) return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    double threshold = 10;
+    int arg = 1;
+    if (argc > 2 && !strcmp(argv[1], "-t")) {
+        threshold = strtod(argv[2], NULL);
+        arg = 3;
+    }
+    if (argc - arg != 2) {
+        fprintf(
+            stderr, "usage: %s [-t percent] baseline current\n", argv[0]
+        );
+        return 2;
+    }
+
+    static struct result base[MAX_RESULTS], cur[MAX_RESULTS];
+    size_t num_base = load(argv[arg], base);
+    size_t num_cur = load(argv[arg + 1], cur);
+    if (!num_cur) {
+        fprintf(stderr, "%s: no benchmark results\n", argv[arg + 1]);
+        return 1;
+    }
+    calibrate(argv[arg], base, num_base);
+    calibrate(argv[arg + 1], cur, num_cur);
+
+    size_t regressions = 0, unmatched = 0;
+    printf(
+        "%-24s %-8s %12s %12s %9s\n",
+        "case", "platform", "base rel", "current rel", "change"
+    );
+    for (size_t i = 0; i < num_cur; i++) {
+        struct result *b = NULL;
+        for (size_t j = 0; j < num_base && !b; j++) {
+            if (
+                    !strcmp(base[j].name, cur[i].name)
+                &&  !strcmp(base[j].platform, cur[i].platform)
+            ) b = &base[j];
+        }
+        if (!b) {
+            printf(
+                "%-24s %-8s %12s %12.3f %9s  NO BASELINE\n",
+                cur[i].name, cur[i].platform, "-", cur[i].rel, "-"
+            );
+            unmatched++;
+            continue;
+        }
+        b->matched = true;
+
+        double change = (cur[i].rel / b->rel - 1) * 100;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        printf(
+            "%-24s %-8s %12.3f %12.3f %+8.1f%%%s\n",
+            cur[i].name, cur[i].platform, b->rel, cur[i].rel, change,
+            (regressed) ? "  REGRESSION" : ""
+        );
+    }
+    for (size_t i = 0; i < num_base; i++) {
+        if (base[i].matched || !has_platform(cur, num_cur, base[i].platform))
+            continue; // NOTE: other platforms are checked by their own runs
+        printf(
+            "%-24s %-8s %12.3f %12s %9s  MISSING\n",
+            base[i].name, base[i].platform, base[i].rel, "-", "-"
+        );
+        unmatched++;
+    }
+
+    if (regressions) {
+        printf(
+            "\n%zu case(s) slowed down by more than %.0f%%\n",
+            regressions, threshold
+        );
+    }
+    if (unmatched) {
+        printf(
+            "\n%zu case(s) missing from either file (update the baseline "
+            "if cases were added or removed)\n",
+            unmatched
+        );
+    }
+    return (regressions || unmatched) ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+ * Host stand-in for the FreeRTOS header, providing just enough for the
+ * firmware's sensing headers (fsr.h, thermistor.h) to be included by the
+ * host tools.
+ */
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
@@ -0,0 +1,377 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "ws.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WS_GUID                     "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_HEAD_MAX                 2048 // max handshake head length
+
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/*
+ * static int tcp_open(const char *host, const char *port, bool nonblock)
+ *  Opens a TCP connection (with Nagle's algorithm disabled).
+ *  Inputs:
+ *   - host     : The host name or address.
+ *   - port     : The port number or service name.
+ *   - nonblock : Whether to return without waiting for the connection.
+ *  Output: The socket, or -1 on failure.
+ */
+static int tcp_open(const char *host, const char *port, bool nonblock) {
+    struct addrinfo hints = { 0 }, *res, *ai;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res)) return -1;
+
+    int fd = -1;
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(
+            ai->ai_family, ai->ai_socktype | ((nonblock) ? SOCK_NONBLOCK : 0),
+            ai->ai_protocol
+        );
+        if (fd < 0) continue;
+        if (!connect(fd, ai->ai_addr, ai->ai_addrlen)) break;
+        if (nonblock && errno == EINPROGRESS) break;
+        close(fd); fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+int tcp_connect(const char *host, const char *port) {
+    return tcp_open(host, port, false);
+}
+
+int tcp_connect_start(const char *host, const char *port) {
+    return tcp_open(host, port, true);
+}
+
+int tcp_listen(const char *port) {
+    struct addrinfo hints = { 0 }, *res;
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(NULL, port, &hints, &res)) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0) {
+        int one = 1, zero = 0;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        if (bind(fd, res->ai_addr, res->ai_addrlen) || listen(fd, 64)) {
+            close(fd); fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+ssize_t http_read_head(int fd, char *buf, size_t len) {
+    size_t n = 0;
+    while (n < len - 1) {
+        if (recv(fd, &buf[n], 1, 0) != 1) return -1;
+        n++;
+        if (n >= 4 && !memcmp(&buf[n - 4], "\r\n\r\n", 4)) {
+            buf[n] = '\0';
+            return n;
+        }
+    }
+    return -1; // overflow
+}
+
+const char *http_header(const char *head, const char *name, size_t *len) {
+    size_t name_len = strlen(name);
+    for (const char *line = strstr(head, "\r\n"); line; ) {
+        line += 2;
+        if (!strncasecmp(line, name, name_len) && line[name_len] == ':') {
+            const char *value = &line[name_len + 1];
+            while (*value == ' ' || *value == '\t') value++;
+            *len = strcspn(value, "\r\n");
+            while (*len && isspace((unsigned char)value[*len - 1])) (*len)--;
+            return value;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return NULL;
+}
+
+/*
+ * static void sha1(const uint8_t *data, size_t len, uint8_t *digest)
+ *  Computes the SHA-1 digest of a message (for the handshake only).
+ *  Inputs:
+ *   - data   : The message.
+ *   - len    : The message length.
+ *   - digest : The output buffer (20 bytes).
+ *  Output: None.
+ */
+static void sha1(const uint8_t *data, size_t len, uint8_t *digest) {
+    uint32_t h[5] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+    };
+    size_t total = ((len + 8) / 64 + 1) * 64; // padded length
+    for (size_t block = 0; block < total; block += 64) {
+        uint32_t w[80];
+        for (size_t i = 0; i < 64; i++) {
+            size_t pos = block + i;
+            uint8_t byte;
+            if (pos < len) byte = data[pos];
+            else if (pos == len) byte = 0x80;
+            else if (pos >= total - 8)
+                byte = ((uint64_t)len * 8) >> (8 * (total - 1 - pos));
+            else byte = 0;
+            if (i % 4 == 0) w[i / 4] = 0;
+            w[i / 4] |= (uint32_t)byte << (8 * (3 - i % 4));
+        }
+        for (size_t i = 16; i < 80; i++) {
+            uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (x << 1) | (x >> 31);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (size_t i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC;
+            }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (size_t i = 0; i < 20; i++) digest[i] = h[i / 4] >> (8 * (3 - i % 4));
+}
+
+/*
+ * static void base64(const uint8_t *data, size_t len, char *out)
+ *  Encodes data in base64.
+ *  Inputs:
+ *   - data : The data.
+ *   - len  : The data length.
+ *   - out  : The output buffer (4 * ceil(len / 3) + 1 bytes).
+ *  Output: None.
+ */
+static void base64(const uint8_t *data, size_t len, char *out) {
+    static const char chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < len) v |= data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        *(out++) = chars[(v >> 18) & 63];
+        *(out++) = chars[(v >> 12) & 63];
+        *(out++) = (i + 1 < len) ? chars[(v >> 6) & 63] : '=';
+        *(out++) = (i + 2 < len) ? chars[v & 63] : '=';
+    }
+    *out = '\0';
+}
+
+void ws_accept_key(const char *key, size_t len, char *accept) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%.*s" WS_GUID, (int)len, key);
+    uint8_t digest[20];
+    sha1((const uint8_t *)buf, strlen(buf), digest);
+    base64(digest, sizeof(digest), accept);
+}
+
+void ws_conn_init(struct ws_conn *conn, int fd, bool mask) {
+    memset(conn, 0, sizeof(struct ws_conn));
+    conn->fd = fd;
+    conn->mask = mask;
+}
+
+void ws_conn_close(struct ws_conn *conn) {
+    if (conn->fd >= 0) close(conn->fd);
+    free(conn->buf); free(conn->msg);
+    ws_conn_init(conn, -1, conn->mask);
+}
+
+int ws_client_request(char *buf, size_t len, const char *host,
+                      const char *path, char *expected) {
+    uint8_t nonce[16]; char key[25];
+    for (size_t i = 0; i < sizeof(nonce); i++) nonce[i] = rand();
+    base64(nonce, sizeof(nonce), key);
+    ws_accept_key(key, strlen(key), expected);
+
+    int ret = snprintf(
+        buf, len,
+        "GET %s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n",
+        path, host, key
+    );
+    return (ret < 0 || (size_t)ret >= len) ? -1 : ret;
+}
+
+bool ws_client_check(const char *head, const char *expected) {
+    size_t accept_len;
+    const char *accept;
+    return
+            !strncmp(head, "HTTP/1.1 101", 12)
+        &&  (accept = http_header(head, "Sec-WebSocket-Accept", &accept_len))
+        &&  accept_len == strlen(expected)
+        &&  !memcmp(accept, expected, accept_len);
+}
+
+int ws_client_open(struct ws_conn *conn, const char *host, const char *port,
+                   const char *path) {
+    ws_conn_init(conn, tcp_connect(host, port), true);
+    if (conn->fd < 0) return -1;
+
+    char head[WS_HEAD_MAX], expected[WS_ACCEPT_LEN];
+    int len = ws_client_request(head, sizeof(head), host, path, expected);
+    if (
+            len < 0
+        ||  send(conn->fd, head, len, MSG_NOSIGNAL) != len
+        ||  http_read_head(conn->fd, head, sizeof(head)) < 0
+        ||  !ws_client_check(head, expected)
+    ) {
+        ws_conn_close(conn);
+        return -1;
+    }
+    return 0;
+}
+
+size_t ws_encode(uint8_t *frame, uint8_t opcode, bool fin, const void *data,
+                 size_t len, bool mask) {
+    size_t n = 0;
+    frame[n++] = ((fin) ? 0x80 : 0) | opcode;
+    uint8_t mask_bit = (mask) ? 0x80 : 0;
+    if (len < 126) frame[n++] = mask_bit | len;
+    else if (len < 65536) {
+        frame[n++] = mask_bit | 126;
+        frame[n++] = len >> 8; frame[n++] = len;
+    } else {
+        frame[n++] = mask_bit | 127;
+        for (int i = 7; i >= 0; i--) frame[n++] = (uint64_t)len >> (8 * i);
+    }
+    uint8_t key[4] = { 0 };
+    if (mask) {
+        for (size_t i = 0; i < 4; i++) frame[n++] = key[i] = rand();
+    }
+    for (size_t i = 0; i < len; i++)
+        frame[n++] = ((const uint8_t *)data)[i] ^ key[i % 4];
+    return n;
+}
+
+int ws_send(struct ws_conn *conn, uint8_t opcode, const void *data,
+            size_t len) {
+    uint8_t *frame = malloc(WS_FRAME_OVERHEAD + len);
+    if (!frame) return -1;
+    size_t n = ws_encode(frame, opcode, true, data, len, conn->mask);
+
+    size_t sent = 0;
+    while (sent < n) {
+        ssize_t ret = send(conn->fd, &frame[sent], n - sent, MSG_NOSIGNAL);
+        if (ret <= 0) break;
+        sent += ret;
+    }
+    free(frame);
+    return (sent == n) ? 0 : -1;
+}
+
+int ws_fill(struct ws_conn *conn, int timeout_ms) {
+    if (conn->fd < 0) return -1;
+    if (conn->cap - conn->len < 4096) {
+        size_t cap = (conn->cap) ? conn->cap * 2 : 16384;
+        uint8_t *buf = realloc(conn->buf, cap);
+        if (!buf) return -1;
+        conn->buf = buf; conn->cap = cap;
+    }
+
+    struct pollfd pfd = { conn->fd, POLLIN, 0 };
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0) return -1;
+    if (!ret) return 0;
+
+    ssize_t len =
+        recv(conn->fd, &conn->buf[conn->len], conn->cap - conn->len, 0);
+    if (len <= 0) return -1;
+    conn->len += len;
+    return 1;
+}
+
+int ws_next(struct ws_conn *conn, struct ws_frame *msg) {
+    while (true) {
+        if (conn->len < 2) return 0;
+        uint8_t *p = conn->buf;
+        bool fin = p[0] & 0x80, masked = p[1] & 0x80;
+        uint8_t opcode = p[0] & 0x0F;
+        uint64_t len = p[1] & 0x7F;
+        size_t head = 2;
+        if (len == 126) {
+            if (conn->len < 4) return 0;
+            len = (p[2] << 8) | p[3];
+            head = 4;
+        } else if (len == 127) {
+            if (conn->len < 10) return 0;
+            len = 0;
+            for (size_t i = 0; i < 8; i++) len = (len << 8) | p[2 + i];
+            head = 10;
+        }
+        if (len > WS_MAX_MSG) return -1;
+        if (masked) head += 4;
+        if (conn->len < head + len) return 0;
+
+        /* move frame out of the receive buffer */
+        if (conn->msg_cap < conn->msg_len + len + 1) {
+            size_t cap = conn->msg_len + len + 1;
+            if (cap < 4096) cap = 4096;
+            uint8_t *buf = realloc(conn->msg, cap);
+            if (!buf) return -1;
+            conn->msg = buf; conn->msg_cap = cap;
+        }
+        uint8_t *payload = &conn->msg[conn->msg_len];
+            // NOTE: control frames may arrive between fragments, so they are
+            // placed after the partial message without extending it
+        for (size_t i = 0; i < len; i++)
+            payload[i] = p[head + i] ^ ((masked) ? p[head - 4 + i % 4] : 0);
+        conn->len -= head + len;
+        memmove(conn->buf, &p[head + len], conn->len);
+
+        if (opcode & 0x8) { // control frame
+            if (!fin) return -1;
+            *msg = (struct ws_frame){ opcode, true, payload, len };
+            return 1;
+        }
+        if ((opcode == WS_OP_CONT) != (conn->msg_op != 0))
+            return -1; // continuation without start or vice versa
+        if (opcode != WS_OP_CONT) conn->msg_op = opcode;
+        conn->msg_len += len;
+        if (conn->msg_len > WS_MAX_MSG) return -1;
+        if (fin) {
+            conn->msg[conn->msg_len] = '\0'; // for convenience with text
+            *msg = (struct ws_frame){
+                conn->msg_op, true, conn->msg, conn->msg_len
+            };
+            conn->msg_op = 0; conn->msg_len = 0;
+            return 1;
+        }
+    }
+}
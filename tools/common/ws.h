@@ -0,0 +1,232 @@
+#pragma once
+
+/*
+ * Minimal blocking TCP/HTTP/WebSocket (RFC 6455) helpers for the host-side
+ * tools, plus the pieces that event loops need to do the same without
+ * blocking. Only what the unit's web server speaks is supported.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* WebSocket opcodes */
+#define WS_OP_CONT                  0x0
+#define WS_OP_TEXT                  0x1
+#define WS_OP_BINARY                0x2
+#define WS_OP_CLOSE                 0x8
+#define WS_OP_PING                  0x9
+#define WS_OP_PONG                  0xA
+
+#define WS_MAX_MSG                  (1 << 20) // max reassembled message size
+#define WS_FRAME_OVERHEAD           14 // max frame header length (incl. mask)
+#define WS_ACCEPT_LEN               29 // Sec-WebSocket-Accept buffer length
+
+/* WebSocket frame/message */
+struct ws_frame {
+    uint8_t opcode; // WS_OP_x
+    bool fin; // set on the final fragment
+    uint8_t *payload; // payload (unmasked)
+    size_t len; // payload length
+};
+
+/* WebSocket connection with receive buffering and message reassembly */
+struct ws_conn {
+    int fd; // socket (-1 if closed)
+    uint8_t *buf; // receive buffer
+    size_t len; // bytes in receive buffer
+    size_t cap; // receive buffer capacity
+    uint8_t *msg; // message being reassembled
+    size_t msg_len; // reassembled message length
+    size_t msg_cap; // reassembly buffer capacity
+    uint8_t msg_op; // opcode of message being reassembled (0 if none)
+    bool mask; // whether to mask sent frames (set for clients)
+};
+
+/*
+ * double now_ms()
+ *  Retrieves a monotonic timestamp.
+ *  Inputs: None.
+ *  Output: The timestamp in milliseconds.
+ */
+double now_ms();
+
+/*
+ * int tcp_connect(const char *host, const char *port)
+ *  Opens a TCP connection (with Nagle's algorithm disabled).
+ *  Inputs:
+ *   - host : The host name or address.
+ *   - port : The port number or service name.
+ *  Output: The socket, or -1 on failure.
+ */
+int tcp_connect(const char *host, const char *port);
+
+/*
+ * int tcp_connect_start(const char *host, const char *port)
+ *  Starts opening a TCP connection without blocking (except for resolving
+ *  the host name). The socket becomes writable once the connection is
+ *  established or has failed (see SO_ERROR).
+ *  Inputs:
+ *   - host : The host name or address.
+ *   - port : The port number or service name.
+ *  Output: The (non-blocking) socket, or -1 on failure.
+ */
+int tcp_connect_start(const char *host, const char *port);
+
+/*
+ * int tcp_listen(const char *port)
+ *  Opens a listening TCP socket on all interfaces.
+ *  Inputs:
+ *   - port : The port number or service name.
+ *  Output: The socket, or -1 on failure.
+ */
+int tcp_listen(const char *port);
+
+/*
+ * ssize_t http_read_head(int fd, char *buf, size_t len)
+ *  Reads an HTTP request/response head (up to and including the empty line)
+ *  byte by byte, so that nothing past it is consumed.
+ *  Inputs:
+ *   - fd  : The socket.
+ *   - buf : The output buffer (null-terminated on success).
+ *   - len : The output buffer's length.
+ *  Output: The head's length, or -1 on failure (including overflow).
+ */
+ssize_t http_read_head(int fd, char *buf, size_t len);
+
+/*
+ * const char *http_header(const char *head, const char *name, size_t *len)
+ *  Looks up a header in an HTTP head (case-insensitively).
+ *  Inputs:
+ *   - head : The null-terminated head.
+ *   - name : The header name.
+ *   - len  : Pointer to the output value length.
+ *  Output: Pointer to the value (not null-terminated), or NULL if absent.
+ */
+const char *http_header(const char *head, const char *name, size_t *len);
+
+/*
+ * void ws_accept_key(const char *key, size_t len, char *accept)
+ *  Computes the Sec-WebSocket-Accept value for a Sec-WebSocket-Key.
+ *  Inputs:
+ *   - key    : The key.
+ *   - len    : The key's length.
+ *   - accept : The output buffer (29 bytes, null-terminated).
+ *  Output: None.
+ */
+void ws_accept_key(const char *key, size_t len, char *accept);
+
+/*
+ * void ws_conn_init(struct ws_conn *conn, int fd, bool mask)
+ *  Initialises a WebSocket connection on an (already upgraded) socket.
+ *  Inputs:
+ *   - conn : The connection.
+ *   - fd   : The socket.
+ *   - mask : Whether sent frames are to be masked (i.e. this is a client).
+ *  Output: None.
+ */
+void ws_conn_init(struct ws_conn *conn, int fd, bool mask);
+
+/*
+ * void ws_conn_close(struct ws_conn *conn)
+ *  Closes a WebSocket connection's socket and frees its buffers.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+void ws_conn_close(struct ws_conn *conn);
+
+/*
+ * int ws_client_request(char *buf, size_t len, const char *host,
+ *                       const char *path, char *expected)
+ *  Formats a client's opening handshake request.
+ *  Inputs:
+ *   - buf      : The output buffer.
+ *   - len      : The output buffer's length.
+ *   - host     : The host name (for the Host header).
+ *   - path     : The request path (e.g. "/ws").
+ *   - expected : The output buffer for the Sec-WebSocket-Accept value to
+ *                expect (WS_ACCEPT_LEN bytes, null-terminated).
+ *  Output: The request's length, or -1 if it does not fit.
+ */
+int ws_client_request(char *buf, size_t len, const char *host,
+                      const char *path, char *expected);
+
+/*
+ * bool ws_client_check(const char *head, const char *expected)
+ *  Checks the server's response to an opening handshake.
+ *  Inputs:
+ *   - head     : The null-terminated response head.
+ *   - expected : The expected Sec-WebSocket-Accept value.
+ *  Output: Whether the server accepted the upgrade.
+ */
+bool ws_client_check(const char *head, const char *expected);
+
+/*
+ * int ws_client_open(struct ws_conn *conn, const char *host,
+ *                    const char *port, const char *path)
+ *  Connects to a WebSocket server and performs the opening handshake.
+ *  Inputs:
+ *   - conn : The connection to be initialised.
+ *   - host : The host name or address.
+ *   - port : The port.
+ *   - path : The request path (e.g. "/ws").
+ *  Output: 0 on success, or -1 on failure.
+ */
+int ws_client_open(struct ws_conn *conn, const char *host, const char *port,
+                   const char *path);
+
+/*
+ * size_t ws_encode(uint8_t *frame, uint8_t opcode, bool fin,
+ *                  const void *data, size_t len, bool mask)
+ *  Encodes a frame, e.g. to send the same frame to many connections.
+ *  Inputs:
+ *   - frame  : The output buffer (len + WS_FRAME_OVERHEAD bytes).
+ *   - opcode : The opcode (WS_OP_x).
+ *   - fin    : Whether this is the final fragment.
+ *   - data   : The payload.
+ *   - len    : The payload length.
+ *   - mask   : Whether to mask the payload (i.e. this is a client).
+ *  Output: The frame's length.
+ */
+size_t ws_encode(uint8_t *frame, uint8_t opcode, bool fin, const void *data,
+                 size_t len, bool mask);
+
+/*
+ * int ws_send(struct ws_conn *conn, uint8_t opcode, const void *data,
+ *             size_t len)
+ *  Sends an unfragmented frame.
+ *  Inputs:
+ *   - conn   : The connection.
+ *   - opcode : The opcode (WS_OP_x).
+ *   - data   : The payload.
+ *   - len    : The payload length.
+ *  Output: 0 on success, or -1 on failure.
+ */
+int ws_send(struct ws_conn *conn, uint8_t opcode, const void *data,
+            size_t len);
+
+/*
+ * int ws_fill(struct ws_conn *conn, int timeout_ms)
+ *  Waits for and reads available data into the receive buffer.
+ *  Inputs:
+ *   - conn       : The connection.
+ *   - timeout_ms : Max time to wait (-1 = forever).
+ *  Output: 1 if data was read, 0 on timeout, or -1 if the connection was
+ *          closed or failed.
+ */
+int ws_fill(struct ws_conn *conn, int timeout_ms);
+
+/*
+ * int ws_next(struct ws_conn *conn, struct ws_frame *msg)
+ *  Pops the next complete message from the receive buffer. Fragmented data
+ *  messages are reassembled; control frames are returned as they arrive.
+ *  The message payload is valid until the next call.
+ *  Inputs:
+ *   - conn : The connection.
+ *   - msg  : Pointer to the output message.
+ *  Output: 1 if a message was popped, 0 if more data is needed, or -1 on a
+ *          protocol error.
+ */
+int ws_next(struct ws_conn *conn, struct ws_frame *msg);
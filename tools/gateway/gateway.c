@@ -0,0 +1,1253 @@
+/*
+ * gateway - ward gateway aggregating many bed units for their dashboards.
+ * Usage: gateway [-p port] [-a assets] -b name=host[:port] [-b ...]
+ *  -p : Port to listen on (default 8000).
+ *  -a : Directory holding index.htm, plot.js, alert.mp3 and optionally
+ *       chart.umd.min.js (default: the firmware's assets).
+ *  -b : A bed unit to aggregate (port 80 if omitted), named for the
+ *       dashboard's ?bed= parameter. Repeat for each bed; the first one is
+ *       shown if no bed is given.
+ * Keeps a single upstream /ws connection to each unit, caches its
+ * temperature history (in a tscomp store, as on the unit) and its latest
+ * occupancy, help and metrics, and serves any number of dashboards from the
+ * cache, so that the units only ever serve the gateway. Dashboards are
+ * opened as http://<gateway>/?bed=<name> and speak the unit's WebSocket
+ * protocol, plus u: messages telling whether the unit is reachable.
+ * POST /clear?bed=<name> is relayed to the unit, and GET /beds lists the
+ * beds' states as JSON.
+ * Everything runs in a single epoll loop. Upstream connections are opened
+ * without blocking (and retried with backoff), each update is encoded once
+ * and queued to every subscribed viewer, and output is buffered per viewer
+ * so that a slow viewer never stalls the others.
+ */
+
+#define _GNU_SOURCE // for accept4()
+
+#include "ws.h"
+#include "tscomp.h"
+#include "webserver.h"
+#include "thermistor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_BEDS                    256 // max number of beds
+#define BED_NAME_LEN                32 // max bed name length (incl. null)
+#define MAX_EVENTS                  64 // max events per epoll_wait()
+#define HEAD_MAX                    4096 // max request/response head length
+#define TICK_PERIOD                 250 // housekeeping period (ms)
+#define CONNECT_TIMEOUT             5000 // upstream connect timeout (ms)
+#define UPSTREAM_TIMEOUT            30000 // upstream silence timeout (ms)
+    // NOTE: units send metrics every WEB_METRICS_PERIOD
+#define RETRY_MIN                   1000 // initial reconnect backoff (ms)
+#define RETRY_MAX                   30000 // max reconnect backoff (ms)
+#define HTTP_TIMEOUT                10000 // max HTTP request duration (ms)
+#define OUT_MAX                     (4 << 20) // max queued output per
+    // connection (bytes), beyond which it is dropped
+#define SCOPE_MAX_QUEUED            65536 // queued output (bytes) beyond
+    // which scope frames are skipped for a viewer
+
+#define UPSTREAM_TOPICS \
+    ((1 << WEB_TOPIC_TEMP) | (1 << WEB_TOPIC_OCC) | (1 << WEB_TOPIC_HELP) \
+     | (1 << WEB_TOPIC_METRICS))
+    // topics always subscribed upstream (scope only while viewers want it)
+
+/* connection kinds */
+enum conn_kind {
+    CONN_HTTP = 0, // viewer HTTP request
+    CONN_VIEWER, // viewer WebSocket
+    CONN_UPSTREAM, // WebSocket to a unit
+    CONN_RELAY // POST /clear relayed to a unit
+};
+
+/* upstream connection states */
+enum up_state {
+    UP_DOWN = 0, // waiting to reconnect
+    UP_CONNECTING, // connecting/handshake sent
+    UP_OPEN // upgraded and subscribed
+};
+
+struct bed;
+
+/* connection */
+struct conn {
+    enum conn_kind kind; // CONN_x
+    struct ws_conn ws; // socket and receive buffering (ws.fd < 0 if closed)
+    struct bed *bed; // bed (NULL for HTTP requests)
+    uint8_t *out; // queued output
+    size_t out_len; // queued output length
+    size_t out_cap; // queued output capacity
+    bool connecting; // set until an outgoing connection is established
+    bool want_out; // set while waiting for the socket to become writable
+    bool closing; // set to close once the queued output is sent
+    double deadline; // time to give up by (0 = never)
+    size_t slot; // index in the bed's viewers (viewers only)
+    uint8_t topics; // subscribed topics (1 << WEB_TOPIC_x, viewers only)
+    uint32_t interval; // min interval between stream updates (ms)
+    double last_sent[WEB_NUM_TOPICS]; // last stream update timestamps (ms)
+    uint8_t pending; // stream topics with a rate limited update to deliver
+    struct conn *prev, *next; // in list of open (or closed) connections
+};
+
+/* bed unit */
+struct bed {
+    char name[BED_NAME_LEN]; // name (for ?bed=)
+    char host[256]; // host name or address
+    char port[8]; // port
+    enum up_state state; // UP_x
+    struct conn *up; // upstream connection (NULL while down)
+    char expected[WS_ACCEPT_LEN]; // expected Sec-WebSocket-Accept
+    double retry_at; // time to reconnect at (while down)
+    double backoff; // reconnect backoff (ms)
+    double last_rx; // time of last upstream data (ms)
+    uint8_t up_topics; // topics subscribed upstream
+    bool synced; // set once history is received on this connection
+    unsigned long connects; // number of successful connections
+    struct ts_block history_blocks[RT_HISTORY_SIZE / TS_BLOCK_SIZE];
+    struct ts_store history; // temperature history
+    bool have_history; // set once history has been received
+    float temp; // latest temperature (C, NAN if none)
+    int occupancy; // latest occupancy (-1 if unknown)
+    int help; // latest help status (-1 if unknown)
+    char metrics[256]; // latest m: message (empty if none)
+    struct conn **viewers; // viewer WebSockets
+    size_t num_viewers; // number of viewers
+    size_t viewers_cap; // viewers capacity
+};
+
+/* static file */
+struct file {
+    const char *uri; // request path
+    const char *name; // file name in assets directory
+    const char *mime; // MIME type
+    bool optional; // not served if missing
+    char *data; // contents
+    size_t len; // length of contents
+};
+
+static struct file files[] = {
+    { "/", "index.htm", "text/html", false, NULL, 0 },
+    { "/index.htm", "index.htm", "text/html", false, NULL, 0 },
+    { "/plot.js", "plot.js", "application/javascript", false, NULL, 0 },
+    { "/chart.umd.min.js", "chart.umd.min.js", "application/javascript",
+      true, NULL, 0 },
+    { "/alert.mp3", "alert.mp3", "audio/mpeg", false, NULL, 0 }
+};
+#define NUM_FILES                   (sizeof(files) / sizeof(struct file))
+
+static struct bed *beds[MAX_BEDS];
+static size_t num_beds = 0;
+
+static const char topic_chars[WEB_NUM_TOPICS] = { 't', 'o', 'h', 'f', 'm' };
+
+static int epfd;
+static struct conn *conns = NULL; // open connections
+static struct conn *closed = NULL; // connections to be freed
+
+/*
+ * static char *load_file(const char *path, size_t *len)
+ *  Loads a file into memory.
+ *  Inputs:
+ *   - path : Path to the file.
+ *   - len  : Pointer to the output length.
+ *  Output: Pointer to the (heap allocated) contents, or NULL on failure.
+ */
+static char *load_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    char *data = malloc(*len + 1);
+    if (data && fread(data, 1, *len, fp) != *len) {
+        free(data); data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+
+/*
+ * static char *embed_chartjs(char *html, size_t *len)
+ *  Makes a dashboard page load Chart.js by replacing its placeholder
+ *  (WEB_CHARTJS_MARKER) with the script tag, as firmware builds embedding
+ *  Chart.js do.
+ *  Inputs:
+ *   - html : The (heap allocated) page, which this takes over.
+ *   - len  : Pointer to the page length, which is updated.
+ *  Output: Pointer to the (heap allocated) new page, or NULL on failure.
+ */
+static char *embed_chartjs(char *html, size_t *len) {
+    static const char marker[] = WEB_CHARTJS_MARKER;
+    static const char script[] = WEB_CHARTJS_SCRIPT;
+    char *pos = memmem(html, *len, marker, sizeof(marker) - 1);
+    if (!pos) return html;
+
+    size_t head = pos - html, tail = *len - head - (sizeof(marker) - 1);
+    char *page = malloc(head + sizeof(script) - 1 + tail);
+    if (page) {
+        memcpy(page, html, head);
+        memcpy(page + head, script, sizeof(script) - 1);
+        memcpy(page + head + sizeof(script) - 1, pos + sizeof(marker) - 1,
+               tail);
+        *len = head + sizeof(script) - 1 + tail;
+    }
+    free(html);
+    return page;
+}
+
+/*
+ * static void log_bed(const struct bed *bed, const char *fmt, ...)
+ *  Logs a message about a bed to stderr.
+ *  Inputs:
+ *   - bed : The bed.
+ *   - fmt : The message's format string, followed by its arguments.
+ *  Output: None.
+ */
+static void log_bed(const struct bed *bed, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+static void log_bed(const struct bed *bed, const char *fmt, ...) {
+    fprintf(stderr, "%s (%s:%s): ", bed->name, bed->host, bed->port);
+    va_list args; va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+/*
+ * static void watch(struct conn *conn, bool out)
+ *  Updates the events a connection is polled for.
+ *  Inputs:
+ *   - conn : The connection.
+ *   - out  : Whether to wait for the socket to become writable.
+ *  Output: None.
+ */
+static void watch(struct conn *conn, bool out) {
+    if (conn->want_out == out) return;
+    struct epoll_event ev = {
+        .events = EPOLLIN | ((out) ? EPOLLOUT : 0), .data.ptr = conn
+    };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, conn->ws.fd, &ev);
+    conn->want_out = out;
+}
+
+/*
+ * static struct conn *conn_new(enum conn_kind kind, int fd, struct bed *bed)
+ *  Creates a connection for a (non-blocking) socket and starts polling it.
+ *  Inputs:
+ *   - kind : The connection kind.
+ *   - fd   : The socket. This is closed on failure.
+ *   - bed  : The bed (NULL for HTTP requests).
+ *  Output: The connection, or NULL on failure.
+ */
+static struct conn *conn_new(enum conn_kind kind, int fd, struct bed *bed) {
+    struct conn *conn = (fd >= 0) ? calloc(1, sizeof(struct conn)) : NULL;
+    if (!conn) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    conn->kind = kind;
+    ws_conn_init(&conn->ws, fd, kind == CONN_UPSTREAM);
+    conn->bed = bed;
+    conn->connecting = kind == CONN_UPSTREAM || kind == CONN_RELAY;
+    conn->want_out = conn->connecting; // wait for connection
+    struct epoll_event ev = {
+        .events = EPOLLIN | ((conn->want_out) ? EPOLLOUT : 0),
+        .data.ptr = conn
+    };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+        close(fd); free(conn);
+        return NULL;
+    }
+
+    conn->next = conns;
+    if (conns) conns->prev = conn;
+    conns = conn;
+    return conn;
+}
+
+static void up_update(struct bed *bed);
+static void up_down(struct bed *bed, const char *reason);
+
+/*
+ * static void conn_close(struct conn *conn)
+ *  Closes a connection, detaching it from its bed. It is freed once the
+ *  current batch of events has been handled.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void conn_close(struct conn *conn) {
+    if (conn->ws.fd < 0) return; // already closed
+    if (conn->kind == CONN_UPSTREAM) {
+        up_down(conn->bed, "connection closed"); // closes conn
+        return;
+    }
+    ws_conn_close(&conn->ws); // also removes the socket from epoll
+
+    if (conn->kind == CONN_VIEWER) { // swap-remove from viewers
+        struct bed *bed = conn->bed;
+        bed->viewers[conn->slot] = bed->viewers[--bed->num_viewers];
+        bed->viewers[conn->slot]->slot = conn->slot;
+        up_update(bed); // scope may no longer be needed
+    }
+
+    if (conn->prev) conn->prev->next = conn->next;
+    else conns = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    conn->prev = NULL; conn->next = closed;
+    closed = conn;
+}
+
+/*
+ * static void flush(struct conn *conn)
+ *  Sends as much queued output as the socket takes without blocking.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void flush(struct conn *conn) {
+    if (conn->ws.fd < 0 || conn->connecting) return;
+    size_t sent = 0;
+    while (sent < conn->out_len) {
+        ssize_t ret = send(
+            conn->ws.fd, &conn->out[sent], conn->out_len - sent,
+            MSG_NOSIGNAL | MSG_DONTWAIT
+        );
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) {
+            conn_close(conn);
+            return;
+        }
+        sent += ret;
+    }
+    conn->out_len -= sent;
+    memmove(conn->out, &conn->out[sent], conn->out_len);
+
+    if (!conn->out_len && conn->closing) conn_close(conn);
+    else watch(conn, conn->out_len > 0);
+}
+
+/*
+ * static void queue(struct conn *conn, const void *data, size_t len)
+ *  Queues output on a connection and sends what it can right away. The
+ *  connection is dropped if too much output is pending.
+ *  Inputs:
+ *   - conn : The connection.
+ *   - data : The data.
+ *   - len  : The data length.
+ *  Output: None.
+ */
+static void queue(struct conn *conn, const void *data, size_t len) {
+    if (conn->ws.fd < 0) return;
+    if (conn->out_len + len > OUT_MAX) {
+        if (conn->bed) log_bed(conn->bed, "dropping a stalled connection");
+        conn_close(conn);
+        return;
+    }
+    if (conn->out_cap < conn->out_len + len) {
+        size_t cap = (conn->out_cap) ? conn->out_cap : 4096;
+        while (cap < conn->out_len + len) cap *= 2;
+        uint8_t *out = realloc(conn->out, cap);
+        if (!out) {
+            conn_close(conn);
+            return;
+        }
+        conn->out = out; conn->out_cap = cap;
+    }
+    memcpy(&conn->out[conn->out_len], data, len);
+    conn->out_len += len;
+    flush(conn);
+}
+
+/*
+ * static void queue_frame(struct conn *conn, uint8_t opcode,
+ *                         const void *data, size_t len)
+ *  Queues a WebSocket frame on a connection.
+ *  Inputs:
+ *   - conn   : The connection.
+ *   - opcode : The opcode (WS_OP_x).
+ *   - data   : The payload.
+ *   - len    : The payload length.
+ *  Output: None.
+ */
+static void queue_frame(struct conn *conn, uint8_t opcode, const void *data,
+                        size_t len) {
+    uint8_t *frame = malloc(WS_FRAME_OVERHEAD + len);
+    if (!frame) return;
+    queue(
+        conn, frame,
+        ws_encode(frame, opcode, true, data, len, conn->ws.mask)
+    );
+    free(frame);
+}
+
+/*
+ * static void queue_text(struct conn *conn, const char *fmt, ...)
+ *  Formats and queues a WebSocket text message.
+ *  Inputs:
+ *   - conn : The connection.
+ *   - fmt  : The message's format string, followed by its arguments.
+ *  Output: None.
+ */
+static void queue_text(struct conn *conn, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+static void queue_text(struct conn *conn, const char *fmt, ...) {
+    char buf[256];
+    va_list args; va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len >= (int)sizeof(buf)) len = sizeof(buf) - 1;
+    queue_frame(conn, WS_OP_TEXT, buf, len);
+}
+
+/*
+ * static void queue_update(struct conn *conn, enum web_topic topic,
+ *                          float value)
+ *  Queues a t:, o: or h: update message (see web_format_update()).
+ *  Inputs:
+ *   - conn  : The connection.
+ *   - topic : The message's topic.
+ *   - value : The temperature or status.
+ *  Output: None.
+ */
+static void queue_update(struct conn *conn, enum web_topic topic,
+                         float value) {
+    char buf[WEB_UPDATE_MAX_LEN];
+    size_t len = web_format_update(buf, sizeof(buf), topic, value);
+    queue_frame(conn, WS_OP_TEXT, buf, len);
+}
+
+/*
+ * static void respond(struct conn *conn, const char *status,
+ *                     const char *mime, const void *body, size_t len)
+ *  Queues an HTTP response, closing the connection once it is sent.
+ *  Inputs:
+ *   - conn   : The connection.
+ *   - status : The status line (e.g. "200 OK").
+ *   - mime   : The content type (NULL if none).
+ *   - body   : The response body.
+ *   - len    : The response body's length.
+ *  Output: None.
+ */
+static void respond(struct conn *conn, const char *status, const char *mime,
+                    const void *body, size_t len) {
+    char head[256];
+    int head_len = snprintf(
+        head, sizeof(head),
+        "HTTP/1.1 %s\r\n%s%s%sContent-Length: %zu\r\n"
+        "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n",
+        status, (mime) ? "Content-Type: " : "", (mime) ? mime : "",
+        (mime) ? "\r\n" : "", len
+    );
+    queue(conn, head, head_len);
+    conn->closing = true; // once the body is sent
+    queue(conn, body, len);
+}
+
+/*
+ * static void send_history(struct conn *viewer)
+ *  Queues a bed's cached temperature history (T: message) to a viewer.
+ *  Inputs:
+ *   - viewer : The viewer.
+ *  Output: None.
+ */
+static void send_history(struct conn *viewer) {
+    static char buf[2 + TS_FORMAT_MAX_LEN * RT_HISTORY_LEN + 1];
+    struct bed *bed = viewer->bed;
+    buf[0] = 'T'; buf[1] = ':';
+
+    struct ts_iter it; ts_iter_init(&it, &bed->history);
+    if (bed->history.count > RT_HISTORY_LEN)
+        ts_iter_skip(&it, bed->history.count - RT_HISTORY_LEN);
+    size_t count;
+    size_t len = 2 + ts_format(&it, &buf[2], RT_HISTORY_LEN, false, &count);
+    queue_frame(viewer, WS_OP_TEXT, buf, len);
+}
+
+/*
+ * static void send_state(struct conn *viewer)
+ *  Queues a bed's cached state for a viewer's topics, as the unit does on
+ *  subscription.
+ *  Inputs:
+ *   - viewer : The viewer.
+ *  Output: None.
+ */
+static void send_state(struct conn *viewer) {
+    struct bed *bed = viewer->bed;
+    queue_text(viewer, "u:%d", bed->state == UP_OPEN);
+    if ((viewer->topics & (1 << WEB_TOPIC_TEMP)) && bed->have_history)
+        send_history(viewer);
+    if ((viewer->topics & (1 << WEB_TOPIC_OCC)) && bed->occupancy >= 0)
+        queue_update(viewer, WEB_TOPIC_OCC, bed->occupancy);
+    if ((viewer->topics & (1 << WEB_TOPIC_HELP)) && bed->help >= 0)
+        queue_update(viewer, WEB_TOPIC_HELP, bed->help);
+}
+
+/*
+ * static void broadcast(struct bed *bed, enum web_topic topic, bool stream,
+ *                       uint8_t opcode, const void *data, size_t len)
+ *  Sends a message to all of a bed's viewers subscribed to a topic,
+ *  encoding it only once. Stream topics are rate limited per viewer (with
+ *  the latest value delivered once the interval ends, see flush_pending()),
+ *  and scope frames are skipped for viewers that are falling behind.
+ *  Inputs:
+ *   - bed    : The bed.
+ *   - topic  : The topic (WEB_NUM_TOPICS for all viewers).
+ *   - stream : Whether the topic is rate limited.
+ *   - opcode : The opcode (WS_OP_x).
+ *   - data   : The payload.
+ *   - len    : The payload length.
+ *  Output: None.
+ */
+static void broadcast(struct bed *bed, enum web_topic topic, bool stream,
+                      uint8_t opcode, const void *data, size_t len) {
+    if (!bed->num_viewers) return;
+    uint8_t *frame = malloc(WS_FRAME_OVERHEAD + len);
+    if (!frame) return;
+    size_t frame_len = ws_encode(frame, opcode, true, data, len, false);
+
+    double now = now_ms();
+    for (size_t i = bed->num_viewers; i-- > 0; ) {
+        // NOTE: backwards, as dropping a viewer moves the last one to i
+        struct conn *viewer = bed->viewers[i];
+        if (topic < WEB_NUM_TOPICS) {
+            if (!(viewer->topics & (1 << topic))) continue;
+            if (stream && now - viewer->last_sent[topic] < viewer->interval) {
+                if (topic != WEB_TOPIC_FORCE) // deliver latest value later
+                    viewer->pending |= 1 << topic;
+                continue;
+            }
+            if (topic == WEB_TOPIC_FORCE && viewer->out_len > SCOPE_MAX_QUEUED)
+                continue;
+            viewer->last_sent[topic] = now;
+            viewer->pending &= ~(1 << topic);
+        }
+        queue(viewer, frame, frame_len);
+    }
+    free(frame);
+}
+
+/*
+ * static void up_update(struct bed *bed)
+ *  Updates the upstream subscription to what the viewers need: the cached
+ *  topics always, and the scope only while a viewer is subscribed to it.
+ *  Inputs:
+ *   - bed : The bed.
+ *  Output: None.
+ */
+static void up_update(struct bed *bed) {
+    if (bed->state != UP_OPEN) return;
+    uint8_t topics = UPSTREAM_TOPICS;
+    for (size_t i = 0; i < bed->num_viewers; i++)
+        topics |= bed->viewers[i]->topics & (1 << WEB_TOPIC_FORCE);
+    if (topics == bed->up_topics) return;
+
+    char msg[2 + WEB_NUM_TOPICS + 1] = "s:";
+    size_t len = 2;
+    for (size_t i = 0; i < WEB_NUM_TOPICS; i++) {
+        if (topics & (1 << i)) msg[len++] = topic_chars[i];
+    }
+    bed->up_topics = topics;
+    queue_frame(bed->up, WS_OP_TEXT, msg, len);
+        // NOTE: the unit resends its history, which refreshes the cache
+}
+
+/*
+ * static void up_start(struct bed *bed)
+ *  Starts connecting to a unit.
+ *  Inputs:
+ *   - bed : The bed.
+ *  Output: None.
+ */
+static void up_start(struct bed *bed) {
+    bed->up = conn_new(
+        CONN_UPSTREAM, tcp_connect_start(bed->host, bed->port), bed
+    );
+    if (!bed->up) {
+        up_down(bed, "cannot connect");
+        return;
+    }
+    bed->state = UP_CONNECTING;
+    bed->up->deadline = now_ms() + CONNECT_TIMEOUT;
+
+    char host[sizeof(bed->host) + sizeof(bed->port) + 1], req[HEAD_MAX];
+    snprintf(host, sizeof(host), "%s:%s", bed->host, bed->port);
+    int len = ws_client_request(req, sizeof(req), host, "/ws", bed->expected);
+    if (len < 0) {
+        up_down(bed, "host name too long");
+        return;
+    }
+    queue(bed->up, req, len); // sent once connected
+}
+
+/*
+ * static void up_down(struct bed *bed, const char *reason)
+ *  Closes the upstream connection to a unit (if any) and schedules a
+ *  reconnect with exponential backoff. Viewers are told if the unit was
+ *  reachable until now.
+ *  Inputs:
+ *   - bed    : The bed.
+ *   - reason : Why the connection is closed (for logging).
+ *  Output: None.
+ */
+static void up_down(struct bed *bed, const char *reason) {
+    bool was_open = bed->state == UP_OPEN;
+    struct conn *up = bed->up;
+    bed->up = NULL;
+    bed->state = UP_DOWN;
+    if (up) {
+        up->kind = CONN_RELAY; // close without coming back here
+        conn_close(up);
+    }
+
+    if (was_open) {
+        bed->backoff = RETRY_MIN;
+        log_bed(bed, "disconnected (%s)", reason);
+        broadcast(bed, WEB_NUM_TOPICS, false, WS_OP_TEXT, "u:0", 3);
+    } else if (bed->backoff < RETRY_MAX) {
+        if (bed->backoff == RETRY_MIN)
+            log_bed(bed, "unreachable (%s), retrying", reason);
+        bed->backoff *= 2;
+        if (bed->backoff > RETRY_MAX) bed->backoff = RETRY_MAX;
+    }
+    bed->retry_at = now_ms() + bed->backoff;
+}
+
+/*
+ * static void up_message(struct bed *bed, const struct ws_frame *msg)
+ *  Caches and fans out a message from a unit.
+ *  Inputs:
+ *   - bed : The bed.
+ *   - msg : The message.
+ *  Output: None.
+ */
+static void up_message(struct bed *bed, const struct ws_frame *msg) {
+    if (msg->opcode == WS_OP_BINARY) {
+        if (msg->len && msg->payload[0] == 'f')
+            broadcast(bed, WEB_TOPIC_FORCE, true, WS_OP_BINARY,
+                      msg->payload, msg->len);
+        return;
+    }
+    if (msg->opcode != WS_OP_TEXT || msg->len < 2 || msg->payload[1] != ':')
+        return;
+
+    const char *data = (const char *)&msg->payload[2];
+    switch (msg->payload[0]) {
+        case 'T': { // full history
+            ts_init(&bed->history, bed->history_blocks,
+                    sizeof(bed->history_blocks) / sizeof(struct ts_block));
+            char *end;
+            for (const char *p = data; *p; p = (*end) ? end + 1 : end) {
+                float temp = strtof(p, &end);
+                if (end == p) break;
+                ts_append(&bed->history, temp);
+                bed->temp = temp;
+            }
+            bed->have_history = true;
+            if (!bed->synced) { // (re)connected - viewers may lack readings
+                bed->synced = true;
+                for (size_t i = bed->num_viewers; i-- > 0; ) {
+                    if (bed->viewers[i]->topics & (1 << WEB_TOPIC_TEMP))
+                        send_history(bed->viewers[i]);
+                }
+            }
+            break;
+        }
+        case 't': // new reading
+            bed->temp = strtof(data, NULL);
+            ts_append(&bed->history, bed->temp);
+            broadcast(bed, WEB_TOPIC_TEMP, true, WS_OP_TEXT, msg->payload,
+                      msg->len);
+            break;
+        case 'o':
+        case 'h': {
+            int *cached = (msg->payload[0] == 'o') ? &bed->occupancy
+                                                   : &bed->help;
+            int value = atoi(data);
+            if (*cached == value) break; // resent on resubscription
+            *cached = value;
+            broadcast(
+                bed, (msg->payload[0] == 'o') ? WEB_TOPIC_OCC : WEB_TOPIC_HELP,
+                false, WS_OP_TEXT, msg->payload, msg->len
+            );
+            break;
+        }
+        case 'm':
+            snprintf(bed->metrics, sizeof(bed->metrics), "%s",
+                     (const char *)msg->payload);
+            broadcast(bed, WEB_TOPIC_METRICS, true, WS_OP_TEXT, msg->payload,
+                      msg->len);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * static void handle_frames(struct conn *conn)
+ *  Handles the complete WebSocket messages received on a viewer or
+ *  upstream connection.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void handle_frames(struct conn *conn) {
+    struct ws_frame msg;
+    int ret = 0;
+    while (conn->ws.fd >= 0 && (ret = ws_next(&conn->ws, &msg)) > 0) {
+        switch (msg.opcode) {
+            case WS_OP_PING:
+                queue_frame(conn, WS_OP_PONG, msg.payload, msg.len);
+                break;
+            case WS_OP_CLOSE:
+                if (conn->kind == CONN_UPSTREAM) {
+                    up_down(conn->bed, "closed by unit");
+                    return;
+                }
+                queue_frame(conn, WS_OP_CLOSE, NULL, 0);
+                conn->closing = true;
+                flush(conn);
+                return;
+            case WS_OP_PONG:
+                break;
+            default:
+                if (conn->kind == CONN_UPSTREAM) {
+                    up_message(conn->bed, &msg);
+                    break;
+                }
+                if (msg.opcode != WS_OP_TEXT || msg.len > WEB_WS_MAX_MSG)
+                    break;
+
+                /* subscription (same syntax as the unit) */
+                const char *p = (const char *)msg.payload;
+                uint8_t topics = 0; uint32_t interval = 0;
+                if (!p[0]) topics = WEB_DEFAULT_TOPICS;
+                else if (p[0] == 's' && p[1] == ':') {
+                    for (p += 2; *p && *p != ','; p++) {
+                        const char *topic =
+                            memchr(topic_chars, *p, WEB_NUM_TOPICS);
+                        if (!topic) break;
+                        topics |= 1 << (topic - topic_chars);
+                    }
+                    if (*p && *p != ',') break; // invalid - ignored
+                    if (*p == ',') interval = strtoul(p + 1, NULL, 10);
+                } else break;
+                conn->topics = topics; conn->interval = interval;
+                conn->pending &= topics;
+                up_update(conn->bed);
+                send_state(conn);
+                break;
+        }
+    }
+    if (conn->ws.fd >= 0 && ret < 0) {
+        if (conn->kind == CONN_UPSTREAM) up_down(conn->bed, "protocol error");
+        else conn_close(conn);
+    }
+}
+
+/*
+ * static ssize_t take_head(struct conn *conn, char *head)
+ *  Removes an HTTP head from the front of a connection's receive buffer.
+ *  Inputs:
+ *   - conn : The connection.
+ *   - head : The output buffer (HEAD_MAX + 1 bytes, null-terminated).
+ *  Output: The head's length, 0 if it is incomplete, or -1 if it is too
+ *          long.
+ */
+static ssize_t take_head(struct conn *conn, char *head) {
+    const uint8_t *buf = conn->ws.buf;
+    for (size_t i = 3; i < conn->ws.len; i++) {
+        if (i >= HEAD_MAX) return -1;
+        if (memcmp(&buf[i - 3], "\r\n\r\n", 4)) continue;
+        memcpy(head, buf, i + 1);
+        head[i + 1] = '\0';
+        conn->ws.len -= i + 1;
+        memmove(conn->ws.buf, &buf[i + 1], conn->ws.len);
+        return i + 1;
+    }
+    return (conn->ws.len >= HEAD_MAX) ? -1 : 0;
+}
+
+/*
+ * static struct bed *find_bed(const char *query, bool *given)
+ *  Looks up the bed named by a query string's bed parameter.
+ *  Inputs:
+ *   - query : The query string (without '?', NULL if none).
+ *   - given : Pointer to the output of whether a bed was named.
+ *  Output: The bed (the first one if none was named), or NULL if unknown.
+ */
+static struct bed *find_bed(const char *query, bool *given) {
+    *given = false;
+    for (const char *p = query; p && *p; ) {
+        size_t len = strcspn(p, "&");
+        if (!strncmp(p, "bed=", 4)) {
+            *given = true;
+            for (size_t i = 0; i < num_beds; i++) {
+                if (
+                        strlen(beds[i]->name) == len - 4
+                    &&  !strncmp(beds[i]->name, p + 4, len - 4)
+                ) return beds[i];
+            }
+            return NULL;
+        }
+        p += len + (p[len] == '&');
+    }
+    return beds[0];
+}
+
+/*
+ * static void send_beds(struct conn *conn)
+ *  Responds with the beds' states as JSON.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void send_beds(struct conn *conn) {
+    char *json = NULL; size_t len = 0;
+    FILE *fp = open_memstream(&json, &len);
+    if (!fp) {
+        respond(conn, "500 Internal Server Error", NULL, "", 0);
+        return;
+    }
+    fputc('[', fp);
+    for (size_t i = 0; i < num_beds; i++) {
+        const struct bed *bed = beds[i];
+        fprintf(
+            fp, "%s{\"name\":\"%s\",\"online\":%s,\"connects\":%lu,"
+            "\"viewers\":%zu,\"temp\":", (i) ? "," : "", bed->name,
+            (bed->state == UP_OPEN) ? "true" : "false", bed->connects,
+            bed->num_viewers
+        );
+        if (isnan(bed->temp)) fputs("null", fp);
+        else fprintf(fp, "%.2f", bed->temp);
+        fprintf(fp, ",\"occupancy\":%s,\"help\":%s}",
+                (bed->occupancy < 0) ? "null" :
+                (bed->occupancy) ? "true" : "false",
+                (bed->help < 0) ? "null" : (bed->help) ? "true" : "false");
+    }
+    fputc(']', fp);
+    fclose(fp);
+    respond(conn, "200 OK", "application/json", json, len);
+    free(json);
+}
+
+/*
+ * static void relay_clear(struct conn *conn, struct bed *bed)
+ *  Relays a help clear request to a unit. The viewer is answered right
+ *  away; the unit's h: message confirms the clear.
+ *  Inputs:
+ *   - conn : The viewer's connection.
+ *   - bed  : The bed.
+ *  Output: None.
+ */
+static void relay_clear(struct conn *conn, struct bed *bed) {
+    if (bed->state != UP_OPEN) {
+        respond(conn, "503 Service Unavailable", "text/plain",
+                "Bed unit unreachable", 20);
+        return;
+    }
+    struct conn *relay = conn_new(
+        CONN_RELAY, tcp_connect_start(bed->host, bed->port), bed
+    );
+    if (!relay) {
+        respond(conn, "502 Bad Gateway", NULL, "", 0);
+        return;
+    }
+    relay->deadline = now_ms() + HTTP_TIMEOUT;
+    char req[HEAD_MAX];
+    int len = snprintf(
+        req, sizeof(req),
+        "POST /clear HTTP/1.1\r\nHost: %s:%s\r\nContent-Length: 0\r\n"
+        "Connection: close\r\n\r\n", bed->host, bed->port
+    );
+    queue(relay, req, len); // sent once connected
+    respond(conn, "202 Accepted", NULL, "", 0);
+}
+
+/*
+ * static void handle_request(struct conn *conn)
+ *  Reads and handles an HTTP request from a viewer.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void handle_request(struct conn *conn) {
+    char head[HEAD_MAX + 1];
+    ssize_t head_len = take_head(conn, head);
+    if (!head_len) return; // incomplete
+    if (head_len < 0) {
+        respond(conn, "431 Request Header Fields Too Large", NULL, "", 0);
+        return;
+    }
+    conn->deadline = now_ms() + HTTP_TIMEOUT; // to send the response
+
+    char method[8], uri[256];
+    if (sscanf(head, "%7s %255s", method, uri) != 2) {
+        respond(conn, "400 Bad Request", NULL, "", 0);
+        return;
+    }
+    char *query = strchr(uri, '?');
+    if (query) *(query++) = '\0';
+
+    bool given;
+    struct bed *bed = find_bed(query, &given);
+    size_t key_len;
+    const char *key = http_header(head, "Sec-WebSocket-Key", &key_len);
+    if (!strcmp(method, "GET") && !strcmp(uri, "/ws") && key) { // upgrade
+        if (!bed) {
+            respond(conn, "404 Not Found", "text/plain", "Unknown bed", 11);
+            return;
+        }
+        if (bed->num_viewers == bed->viewers_cap) {
+            size_t cap = (bed->viewers_cap) ? bed->viewers_cap * 2 : 16;
+            struct conn **viewers =
+                realloc(bed->viewers, cap * sizeof(struct conn *));
+            if (!viewers) {
+                respond(conn, "503 Service Unavailable", NULL, "", 0);
+                return;
+            }
+            bed->viewers = viewers; bed->viewers_cap = cap;
+        }
+
+        char accept[WS_ACCEPT_LEN], resp[256];
+        ws_accept_key(key, key_len, accept);
+        int len = snprintf(
+            resp, sizeof(resp),
+            "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+            "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept
+        );
+        conn->kind = CONN_VIEWER; conn->bed = bed; conn->deadline = 0;
+        conn->topics = WEB_DEFAULT_TOPICS;
+        conn->slot = bed->num_viewers;
+        bed->viewers[bed->num_viewers++] = conn;
+        queue(conn, resp, len);
+        queue_text(conn, "u:%d", bed->state == UP_OPEN);
+        handle_frames(conn); // anything sent right after the request
+        return;
+    }
+
+    if (!strcmp(method, "GET")) {
+        for (size_t i = 0; i < NUM_FILES; i++) {
+            if (!files[i].data || strcmp(uri, files[i].uri)) continue;
+            respond(conn, "200 OK", files[i].mime, files[i].data,
+                    files[i].len);
+            return;
+        }
+        if (!strcmp(uri, "/beds")) {
+            send_beds(conn);
+            return;
+        }
+    } else if (!strcmp(method, "POST") && !strcmp(uri, "/clear")) {
+        if (bed) relay_clear(conn, bed);
+        else respond(conn, "404 Not Found", "text/plain", "Unknown bed", 11);
+        return;
+    }
+
+    respond(conn, "404 Not Found", "text/plain", "Not found", 9);
+}
+
+/*
+ * static void handle_upstream(struct conn *conn)
+ *  Handles data received on an upstream connection: the handshake
+ *  response, and then the unit's messages.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void handle_upstream(struct conn *conn) {
+    struct bed *bed = conn->bed;
+    bed->last_rx = now_ms();
+    if (bed->state == UP_CONNECTING) {
+        char head[HEAD_MAX + 1];
+        ssize_t head_len = take_head(conn, head);
+        if (!head_len) return; // incomplete
+        if (head_len < 0 || !ws_client_check(head, bed->expected)) {
+            up_down(bed, "upgrade refused");
+            return;
+        }
+
+        bed->state = UP_OPEN;
+        bed->connects++;
+        bed->backoff = RETRY_MIN;
+        bed->synced = false;
+        bed->up_topics = 0;
+        conn->deadline = 0;
+        log_bed(bed, "connected");
+        up_update(bed);
+        broadcast(bed, WEB_NUM_TOPICS, false, WS_OP_TEXT, "u:1", 3);
+    }
+    handle_frames(conn);
+}
+
+/*
+ * static void handle_relay(struct conn *conn)
+ *  Handles the unit's response to a relayed request.
+ *  Inputs:
+ *   - conn : The connection.
+ *  Output: None.
+ */
+static void handle_relay(struct conn *conn) {
+    char head[HEAD_MAX + 1];
+    ssize_t head_len = take_head(conn, head);
+    if (!head_len) return; // incomplete
+    if (head_len < 0 || strncmp(head, "HTTP/1.1 200", 12))
+        log_bed(conn->bed, "help clear failed");
+    conn_close(conn);
+}
+
+/*
+ * static void handle_event(struct conn *conn, uint32_t events)
+ *  Handles readiness of a connection's socket.
+ *  Inputs:
+ *   - conn   : The connection.
+ *   - events : The epoll events.
+ *  Output: None.
+ */
+static void handle_event(struct conn *conn, uint32_t events) {
+    if (conn->connecting) {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        int err = 0; socklen_t err_len = sizeof(err);
+        getsockopt(conn->ws.fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        if (err) {
+            if (conn->kind == CONN_UPSTREAM)
+                up_down(conn->bed, strerror(err));
+            else {
+                log_bed(conn->bed, "help clear failed (%s)", strerror(err));
+                conn_close(conn);
+            }
+            return;
+        }
+        conn->connecting = false;
+        flush(conn); // request
+        return;
+    }
+
+    if (events & EPOLLOUT) flush(conn);
+    if (conn->ws.fd < 0 || !(events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+        return;
+
+    int ret = ws_fill(&conn->ws, 0);
+    if (!ret) return;
+    if (ret < 0) {
+        if (conn->kind == CONN_UPSTREAM)
+            up_down(conn->bed, "connection closed");
+        else if (conn->kind == CONN_RELAY && conn->ws.len)
+            handle_relay(conn); // response without a blank line
+        else conn_close(conn);
+        return;
+    }
+
+    switch (conn->kind) {
+        case CONN_HTTP: handle_request(conn); break;
+        case CONN_VIEWER: handle_frames(conn); break;
+        case CONN_UPSTREAM: handle_upstream(conn); break;
+        case CONN_RELAY: handle_relay(conn); break;
+    }
+}
+
+/*
+ * static void flush_pending(struct bed *bed)
+ *  Delivers a bed's latest temperature and metrics to the viewers that
+ *  missed an update due to rate limiting and whose interval has since
+ *  elapsed, so that a viewer's last update is never lost (trailing edge).
+ *  Like on the unit, skipped scope frames are not delivered late.
+ *  Inputs:
+ *   - bed : The bed.
+ *  Output: None.
+ */
+static void flush_pending(struct bed *bed) {
+    double now = now_ms();
+    for (size_t i = bed->num_viewers; i-- > 0; ) {
+        struct conn *viewer = bed->viewers[i];
+        if (!viewer->pending) continue;
+        for (size_t topic = 0; topic < WEB_NUM_TOPICS; topic++) {
+            if (!(viewer->pending & (1 << topic))) continue;
+            if (now - viewer->last_sent[topic] < viewer->interval) continue;
+            viewer->pending &= ~(1 << topic);
+            viewer->last_sent[topic] = now;
+            if (topic == WEB_TOPIC_TEMP)
+                queue_update(viewer, WEB_TOPIC_TEMP, bed->temp);
+            else if (topic == WEB_TOPIC_METRICS && bed->metrics[0])
+                queue_text(viewer, "%s", bed->metrics);
+        }
+    }
+}
+
+/*
+ * static void housekeeping()
+ *  Reconnects to units, delivers rate limited updates and times out stalled
+ *  connections.
+ *  Inputs: None.
+ *  Output: None.
+ */
+static void housekeeping() {
+    double now = now_ms();
+    for (size_t i = 0; i < num_beds; i++) {
+        struct bed *bed = beds[i];
+        if (bed->state == UP_DOWN && now >= bed->retry_at) up_start(bed);
+        else if (bed->state == UP_OPEN && now - bed->last_rx > UPSTREAM_TIMEOUT)
+            up_down(bed, "unit silent");
+        flush_pending(bed);
+    }
+
+    for (struct conn *conn = conns, *next; conn; conn = next) {
+        if (conn->ws.fd < 0) break; // closed along the way (now in closed)
+        next = conn->next;
+        if (!conn->deadline || now < conn->deadline) continue;
+        if (conn->kind == CONN_UPSTREAM) up_down(conn->bed, "timed out");
+        else conn_close(conn);
+    }
+}
+
+/*
+ * static struct bed *parse_bed(const char *spec)
+ *  Creates a bed from a name=host[:port] command line argument.
+ *  Inputs:
+ *   - spec : The argument.
+ *  Output: The bed, or NULL if the argument is invalid.
+ */
+static struct bed *parse_bed(const char *spec) {
+    const char *eq = strchr(spec, '=');
+    size_t name_len = (eq) ? (size_t)(eq - spec) : 0;
+    if (!name_len || name_len >= BED_NAME_LEN) return NULL;
+    if (strspn(spec, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                     "0123456789_-") != name_len)
+        return NULL; // used unescaped in URLs and JSON
+
+    const char *host = eq + 1, *colon = strrchr(host, ':');
+    size_t host_len = (colon) ? (size_t)(colon - host) : strlen(host);
+    const char *port = (colon) ? colon + 1 : "80";
+    struct bed *bed = calloc(1, sizeof(struct bed));
+    if (
+            !bed || !host_len || host_len >= sizeof(bed->host)
+        ||  !*port || strlen(port) >= sizeof(bed->port)
+    ) {
+        free(bed);
+        return NULL;
+    }
+
+    memcpy(bed->name, spec, name_len);
+    memcpy(bed->host, host, host_len);
+    strcpy(bed->port, port);
+    ts_init(&bed->history, bed->history_blocks,
+            sizeof(bed->history_blocks) / sizeof(struct ts_block));
+    bed->temp = NAN; bed->occupancy = -1; bed->help = -1;
+    bed->backoff = RETRY_MIN;
+    return bed;
+}
+
+int main(int argc, char **argv) {
+    const char *port = "8000", *assets = FW_DIR "/assets";
+    int opt;
+    while ((opt = getopt(argc, argv, "p:a:b:")) != -1) {
+        switch (opt) {
+            case 'p': port = optarg; break;
+            case 'a': assets = optarg; break;
+            case 'b':
+                if (num_beds == MAX_BEDS) {
+                    fprintf(stderr, "too many beds (max %d)\n", MAX_BEDS);
+                    return 1;
+                }
+                if (!(beds[num_beds] = parse_bed(optarg))) {
+                    fprintf(stderr, "invalid bed: %s\n", optarg);
+                    return 1;
+                }
+                for (size_t i = 0; i < num_beds; i++) {
+                    if (strcmp(beds[i]->name, beds[num_beds]->name)) continue;
+                    fprintf(stderr, "duplicate bed: %s\n", beds[i]->name);
+                    return 1;
+                }
+                num_beds++;
+                break;
+            default:
+                num_beds = 0;
+                break;
+        }
+    }
+    if (!num_beds || optind < argc) {
+        fprintf(
+            stderr, "usage: %s [-p port] [-a assets] -b name=host[:port] "
+            "[-b ...]\n", argv[0]
+        );
+        return 1;
+    }
+
+    bool chartjs = false; // set if Chart.js is available
+    for (size_t i = 0; i < NUM_FILES; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", assets, files[i].name);
+        files[i].data = load_file(path, &files[i].len);
+        if (!files[i].data && !files[i].optional) {
+            fprintf(stderr, "cannot load %s\n", path);
+            return 1;
+        }
+        if (files[i].data && !strcmp(files[i].name, "chart.umd.min.js"))
+            chartjs = true;
+    }
+    for (size_t i = 0; chartjs && i < NUM_FILES; i++) {
+        if (strcmp(files[i].name, "index.htm")) continue;
+        files[i].data = embed_chartjs(files[i].data, &files[i].len);
+        if (!files[i].data) {
+            fprintf(stderr, "cannot load %s\n", files[i].name);
+            return 1;
+        }
+    } // so that dashboards only load Chart.js if it is available
+
+    int listener = tcp_listen(port);
+    if (listener < 0) {
+        perror("cannot listen");
+        return 1;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+
+    epfd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev)) {
+        perror("cannot poll");
+        return 1;
+    }
+    fprintf(stderr, "listening on port %s for %zu beds\n", port, num_beds);
+
+    double next_tick = 0;
+    while (true) {
+        double now = now_ms();
+        if (now >= next_tick) {
+            housekeeping();
+            next_tick = now + TICK_PERIOD;
+        }
+
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epfd, events, MAX_EVENTS, TICK_PERIOD);
+        for (int i = 0; i < n; i++) {
+            struct conn *conn = events[i].data.ptr;
+            if (!conn) { // new viewer connections
+                int fd;
+                while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK))
+                        >= 0) {
+                    conn = conn_new(CONN_HTTP, fd, NULL);
+                    if (conn) conn->deadline = now_ms() + HTTP_TIMEOUT;
+                }
+                continue;
+            }
+            if (conn->ws.fd >= 0) handle_event(conn, events[i].events);
+        }
+
+        while (closed) { // free connections closed by this batch
+            struct conn *conn = closed;
+            closed = conn->next;
+            free(conn->out); free(conn);
+        }
+    }
+}
@@ -0,0 +1,210 @@
+/*
+ * guardcheck - checks a unit running a guard build (sdkconfig.guard) for
+ * heap allocations by guarded code in request paths that steady-state
+ * traffic does not reach, such as POST /clear.
+ * Usage: guardcheck [-p port] [-n requests] host
+ *  -p : Port (default 80).
+ *  -n : Number of POST /clear requests (default 5).
+ * Subscribes to help updates and metrics over /ws, reads the guard counters
+ * from an m: message, exercises the request paths, and reads them again
+ * from the next m: message. Fails if a request fails, if the violation
+ * count went up (count level), or if the unit dropped the connection or
+ * restarted (abort level).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "ws.h"
+#include "webserver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define METRICS_TIMEOUT             (3 * WEB_METRICS_PERIOD) // max wait (ms)
+#define UPDATE_TIMEOUT              2000 // max wait for an h: update (ms)
+
+/* guard counters from an m: message */
+struct metrics {
+    unsigned long uptime; // uptime (s)
+    unsigned long allocs; // heap allocations after boot
+    unsigned long violations; // allocations by guarded code
+};
+
+/*
+ * static int wait_message(struct ws_conn *conn, const char *prefix,
+ *                         int timeout_ms, char *buf, size_t len)
+ *  Waits for a text message starting with a prefix, skipping others.
+ *  Inputs:
+ *   - conn       : The connection.
+ *   - prefix     : The message prefix (e.g. "m:").
+ *   - timeout_ms : Max time to wait.
+ *   - buf        : The output buffer for the message (null-terminated).
+ *   - len        : The output buffer's length.
+ *  Output: 1 if the message arrived, 0 on timeout, or -1 if the connection
+ *          was closed or failed.
+ */
+static int wait_message(struct ws_conn *conn, const char *prefix,
+                        int timeout_ms, char *buf, size_t len) {
+    double deadline = now_ms() + timeout_ms;
+    while (true) {
+        struct ws_frame msg;
+        int ret;
+        while ((ret = ws_next(conn, &msg)) > 0) {
+            if (msg.opcode == WS_OP_CLOSE) return -1;
+            if (
+                    msg.opcode != WS_OP_TEXT
+                ||  msg.len < strlen(prefix)
+                ||  memcmp(msg.payload, prefix, strlen(prefix))
+            ) continue;
+            size_t n = (msg.len < len - 1) ? msg.len : len - 1;
+            memcpy(buf, msg.payload, n); buf[n] = '\0';
+            return 1;
+        }
+        if (ret < 0) return -1;
+
+        double left = deadline - now_ms();
+        if (left <= 0) return 0;
+        ret = ws_fill(conn, (int)left);
+        if (ret <= 0) return ret;
+    }
+}
+
+/*
+ * static bool parse_metrics(const char *msg, struct metrics *metrics)
+ *  Extracts the guard counters from an m: message (see
+ *  web_ws_send_metrics() for the field order).
+ *  Inputs:
+ *   - msg     : The message.
+ *   - metrics : Pointer to the output counters.
+ *  Output: Whether the message holds all fields.
+ */
+static bool parse_metrics(const char *msg, struct metrics *metrics) {
+    unsigned long fields[14];
+    const char *p = msg + 2;
+    for (size_t i = 0; i < 14; i++) {
+        char *end;
+        fields[i] = strtoul(p, &end, 10);
+        if (end == p || (i < 13 && *end != ',')) return false;
+        p = end + 1;
+    }
+    metrics->uptime = fields[0];
+    metrics->allocs = fields[12];
+    metrics->violations = fields[13];
+    return true;
+}
+
+/*
+ * static bool post_clear(const char *host, const char *port)
+ *  Sends POST /clear.
+ *  Inputs:
+ *   - host : The unit's host name or address.
+ *   - port : The unit's port.
+ *  Output: Whether the unit answered 200 OK.
+ */
+static bool post_clear(const char *host, const char *port) {
+    int fd = tcp_connect(host, port);
+    if (fd < 0) return false;
+    char buf[1024];
+    int len = snprintf(
+        buf, sizeof(buf), "POST /clear HTTP/1.1\r\nHost: %s\r\n"
+        "Content-Length: 0\r\nConnection: close\r\n\r\n", host
+    );
+    bool ok =
+            write(fd, buf, len) == len
+        &&  http_read_head(fd, buf, sizeof(buf)) > 0
+        &&  !strncmp(buf, "HTTP/1.1 200", 12);
+    close(fd);
+    return ok;
+}
+
+/*
+ * static bool read_metrics(struct ws_conn *conn, struct metrics *metrics)
+ *  Waits for the next m: message and extracts its guard counters.
+ *  Inputs:
+ *   - conn    : The connection.
+ *   - metrics : Pointer to the output counters.
+ *  Output: Whether the counters were read.
+ */
+static bool read_metrics(struct ws_conn *conn, struct metrics *metrics) {
+    char msg[256];
+    int ret = wait_message(conn, "m:", METRICS_TIMEOUT, msg, sizeof(msg));
+    if (ret < 0) {
+        fprintf(stderr, "connection lost (did the guard abort?)\n");
+        return false;
+    }
+    if (!ret || !parse_metrics(msg, metrics)) {
+        fprintf(stderr, "no (valid) metrics received\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *port = "80";
+    unsigned requests = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:")) != -1) {
+        switch (opt) {
+            case 'p': port = optarg; break;
+            case 'n': requests = strtoul(optarg, NULL, 10); break;
+            default: optind = argc + 1; break;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(
+            stderr, "usage: %s [-p port] [-n requests] host\n", argv[0]
+        );
+        return 2;
+    }
+    const char *host = argv[optind];
+
+    struct ws_conn conn;
+    if (ws_client_open(&conn, host, port, "/ws")) {
+        fprintf(stderr, "cannot connect to %s:%s\n", host, port);
+        return 1;
+    }
+    ws_send(&conn, WS_OP_TEXT, "s:hm", 4);
+
+    struct metrics before, after;
+    char msg[256];
+    if (!read_metrics(&conn, &before)) return 1;
+    printf(
+        "before: uptime %lu s, %lu allocations, %lu violations\n",
+        before.uptime, before.allocs, before.violations
+    );
+
+    for (unsigned i = 0; i < requests; i++) {
+        if (!post_clear(host, port)) {
+            fprintf(stderr, "POST /clear failed\n");
+            return 1;
+        }
+        if (wait_message(&conn, "h:", UPDATE_TIMEOUT, msg, sizeof(msg)) < 1) {
+            fprintf(stderr, "no help update after POST /clear\n");
+            return 1;
+        }
+    }
+
+    if (!read_metrics(&conn, &after)) return 1;
+    printf(
+        "after:  uptime %lu s, %lu allocations, %lu violations\n",
+        after.uptime, after.allocs, after.violations
+    );
+    ws_conn_close(&conn);
+
+    if (after.uptime < before.uptime) {
+        fprintf(stderr, "unit restarted\n");
+        return 1;
+    }
+    if (after.violations > before.violations) {
+        fprintf(
+            stderr, "%lu new violation(s)\n",
+            after.violations - before.violations
+        );
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * trace2json - converts a trace recording downloaded from the unit's
+ * /trace endpoint into Chrome trace event JSON, which can be opened in
+ * Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * Usage: trace2json trace.bin [trace.json]
+ *  trace.bin  : The recording, e.g. downloaded with
+ *                 curl -X POST http://<unit>/trace/freeze
+ *                 curl -o trace.bin http://<unit>/trace
+ *  trace.json : The output file (default: standard output).
+ * The timeline shows which task ran on each core, ADC reads (including the
+ * wait for the ADC mutex) per channel, WebSocket sends per client, and
+ * event group bit sets as instant events. Time 0 is the oldest record.
+ */
+
+#include "trace.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LANES                   64 // max ADC channels/WebSocket clients
+
+/* process IDs for the timeline's tracks */
+enum { PID_CPU = 0, PID_ADC, PID_WS };
+
+/* open slice on a track */
+struct slice {
+    bool open; // set while a slice is open
+    uint64_t start; // start time (us)
+    uint32_t arg; // argument of the opening record
+};
+
+static struct trace_task *tasks;
+static size_t num_tasks;
+static FILE *out;
+static bool first_event = true;
+
+/*
+ * static const char *task_name(uint32_t handle, char *buf)
+ *  Looks up the name of a task.
+ *  Inputs:
+ *   - handle : The task handle.
+ *   - buf    : A buffer for generated names (at least 32 bytes).
+ *  Output: The task's name.
+ */
+static const char *task_name(uint32_t handle, char *buf) {
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].handle != handle) continue;
+        memcpy(buf, tasks[i].name, TRACE_TASK_NAME_LEN);
+        buf[TRACE_TASK_NAME_LEN] = '\0';
+        return buf;
+    }
+    sprintf(buf, "task@0x%08" PRIx32, handle); // exited task
+    return buf;
+}
+
+/*
+ * event(fmt, ...)
+ *  Writes out a trace event (a JSON object), separating it from the
+ *  previous one.
+ *  Inputs:
+ *   - fmt : The event's printf format, followed by its arguments.
+ */
+#define event(...) do { \
+    fprintf(out, (first_event) ? "\n  " : ",\n  "); \
+    fprintf(out, __VA_ARGS__); \
+    first_event = false; \
+} while (0)
+
+/*
+ * static void name_track(int pid, int tid, const char *name)
+ *  Writes out metadata naming a track (thread) of the timeline.
+ *  Inputs:
+ *   - pid  : The track's process ID.
+ *   - tid  : The track's thread ID.
+ *   - name : The track's name.
+ *  Output: None.
+ */
+static void name_track(int pid, int tid, const char *name) {
+    event(
+        "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+        "\"args\":{\"name\":\"%s\"}}", pid, tid, name
+    );
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s trace.bin [trace.json]\n", argv[0]);
+        return 1;
+    }
+
+    /* load recording */
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+    struct trace_header header;
+    if (
+            fread(&header, sizeof(header), 1, file) != 1
+        ||  memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic))
+        ||  header.version != TRACE_VERSION
+        ||  header.record_size != sizeof(struct trace_record)
+    ) {
+        fprintf(stderr, "%s: not a (supported) trace recording\n", argv[1]);
+        return 1;
+    }
+    num_tasks = header.num_tasks;
+    tasks = calloc(num_tasks + 1, sizeof(struct trace_task));
+    struct trace_record *records =
+        calloc(header.num_records + 1, sizeof(struct trace_record));
+    if (
+            fread(tasks, sizeof(struct trace_task), num_tasks, file)
+                != num_tasks
+        ||  fread(records, sizeof(struct trace_record), header.num_records,
+                  file) != header.num_records
+    ) {
+        fprintf(stderr, "%s: truncated recording\n", argv[1]);
+        return 1;
+    }
+    fclose(file);
+
+    out = (argc > 2) ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    event(
+        "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,"
+        "\"args\":{\"name\":\"CPU\"}}", PID_CPU
+    );
+    event(
+        "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,"
+        "\"args\":{\"name\":\"ADC\"}}", PID_ADC
+    );
+    event(
+        "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,"
+        "\"args\":{\"name\":\"WebSocket sends\"}}", PID_WS
+    );
+
+    struct slice running[MAX_LANES] = { 0 }; // running task per core
+    struct slice adc[MAX_LANES] = { 0 }; // ADC read per channel
+    struct slice ws[MAX_LANES] = { 0 }; // WebSocket send per client
+    bool named_core[MAX_LANES] = { 0 }, named_adc[MAX_LANES] = { 0 };
+    bool named_ws[MAX_LANES] = { 0 };
+    char name[64], label[32];
+    uint64_t now = 0; // unwrapped timestamp (us)
+    size_t skipped = 0;
+
+    for (size_t i = 0; i < header.num_records; i++) {
+        const struct trace_record *r = &records[i];
+        int32_t delta = (i) ? (int32_t)(r->stamp - records[i - 1].stamp) : 0;
+        if (delta > 0) now += delta;
+            // NOTE: handles wraparound, and clamps the slight reordering
+            // between concurrent writers so that time never goes back
+        size_t lane = r->arg16;
+
+        switch (r->type) {
+            case TRACE_TASK_IN: {
+                if (r->core >= MAX_LANES) { skipped++; break; }
+                struct slice *s = &running[r->core];
+                if (!named_core[r->core]) {
+                    sprintf(label, "core %u", r->core);
+                    name_track(PID_CPU, r->core, label);
+                    named_core[r->core] = true;
+                }
+                if (s->open && now > s->start) {
+                    event(
+                        "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,"
+                        "\"tid\":%u,\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 "}",
+                        task_name(s->arg, name), PID_CPU, r->core,
+                        s->start, now - s->start
+                    );
+                }
+                *s = (struct slice){ true, now, r->arg };
+                break;
+            }
+
+            case TRACE_ADC_BEGIN:
+            case TRACE_WS_BEGIN: {
+                if (lane >= MAX_LANES) { skipped++; break; }
+                struct slice *s =
+                    (r->type == TRACE_ADC_BEGIN) ? &adc[lane] : &ws[lane];
+                *s = (struct slice){ true, now, r->arg };
+                break;
+            }
+
+            case TRACE_ADC_END:
+                if (lane >= MAX_LANES || !adc[lane].open) { skipped++; break; }
+                if (!named_adc[lane]) {
+                    sprintf(label, "channel %zu", lane);
+                    name_track(PID_ADC, lane, label);
+                    named_adc[lane] = true;
+                }
+                event(
+                    "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%zu,"
+                    "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ","
+                    "\"args\":{\"raw\":%" PRId32 "}}",
+                    (r->arg == UINT32_MAX) ? "adc_read (failed)" : "adc_read",
+                    PID_ADC, lane, adc[lane].start, now - adc[lane].start,
+                    (int32_t)r->arg
+                );
+                adc[lane].open = false;
+                break;
+
+            case TRACE_WS_END:
+                if (lane >= MAX_LANES || !ws[lane].open) { skipped++; break; }
+                if (!named_ws[lane]) {
+                    sprintf(label, "client fd %zu", lane);
+                    name_track(PID_WS, lane, label);
+                    named_ws[lane] = true;
+                }
+                event(
+                    "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%zu,"
+                    "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ","
+                    "\"args\":{\"bytes\":%" PRIu32 ",\"err\":%" PRId32 "}}",
+                    (r->arg) ? "ws_send (failed)" : "ws_send",
+                    PID_WS, lane, ws[lane].start, now - ws[lane].start,
+                    ws[lane].arg, (int32_t)r->arg
+                );
+                ws[lane].open = false;
+                break;
+
+            case TRACE_EVENT_SET:
+                event(
+                    "{\"ph\":\"i\",\"s\":\"t\",\"name\":\"bits 0x%" PRIx32
+                    "\",\"pid\":%d,\"tid\":%u,\"ts\":%" PRIu64 "}",
+                    r->arg, PID_CPU, r->core, now
+                );
+                break;
+
+            default:
+                skipped++;
+        }
+    }
+
+    for (size_t core = 0; core < MAX_LANES; core++) { // close running tasks
+        struct slice *s = &running[core];
+        if (!s->open || now <= s->start) continue;
+        event(
+            "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%zu,"
+            "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 "}",
+            task_name(s->arg, name), PID_CPU, core, s->start, now - s->start
+        );
+    }
+
+    fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+
+    fprintf(
+        stderr, "%" PRIu32 " records (%" PRIu32 " taken), %zu tasks, "
+        "%.3f s", header.num_records, header.total, num_tasks, now / 1e6
+    );
+    if (skipped) fprintf(stderr, ", %zu records skipped", skipped);
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * tsbench - host benchmark for the compressed temperature history (tscomp).
+ * Usage: tsbench [file]
+ *  file : Recorded temperatures (one per line, or comma-separated as in the
+ *         T: WebSocket message). If omitted, a synthetic thermistor trace is
+ *         generated instead.
+ * Reports the storage cost per sample and encode/decode throughput, along
+ * with how much history fits in the firmware's RT_HISTORY_SIZE budget.
+ */
+
+#include "tscomp.h"
+#include "thermistor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SYNTH_LEN                   100000 // synthetic trace length
+#define ROUNDS                      50 // benchmark rounds
+
+/*
+ * static double now_sec()
+ *  Retrieves a monotonic high-resolution timestamp.
+ *  Inputs: None.
+ *  Output: The timestamp in seconds.
+ */
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * static float *load_trace(const char *path, size_t *len)
+ *  Loads recorded temperatures from a file.
+ *  Inputs:
+ *   - path : Path to the file.
+ *   - len  : Pointer to the output sample count.
+ *  Output: Pointer to the (heap allocated) samples, or NULL on failure.
+ */
+static float *load_trace(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return NULL;
+
+    size_t cap = 1024; *len = 0;
+    float *trace = malloc(cap * sizeof(float));
+    char tok[32]; int c; size_t n = 0;
+    do {
+        c = fgetc(fp);
+        if (c == ',' || c == '\n' || c == '\r' || c == ' ' || c == EOF) {
+            if (!n) continue;
+            tok[n] = '\0'; n = 0;
+            if (*len == cap) trace = realloc(trace, (cap *= 2) * sizeof(float));
+            trace[(*len)++] = (strcmp(tok, "nan") == 0) ? NAN : strtof(tok, NULL);
+        } else if (n < sizeof(tok) - 1 && c != 'T' && c != ':') tok[n++] = c;
+    } while (c != EOF);
+
+    fclose(fp);
+    return trace;
+}
+
+/*
+ * static float *synth_trace(size_t len)
+ *  Generates a synthetic body temperature trace: slow diurnal drift and
+ *  occasional fever episodes, quantised through a 12-bit ADC reading.
+ *  Inputs:
+ *   - len : Number of samples to generate.
+ *  Output: Pointer to the (heap allocated) samples.
+ */
+static float *synth_trace(size_t len) {
+    float *trace = malloc(len * sizeof(float));
+    srand(329);
+    float fever = 0;
+    for (size_t i = 0; i < len; i++) {
+        float t = 36.8f + 0.4f * sinf(
+            2 * (float)M_PI * i / (24 * 60 / RT_SENSE_PERIOD)
+        ); // diurnal cycle
+        if (rand() % 2000 == 0) fever = 2.5f; // fever onset
+        fever *= 0.995f;
+        float noise = ((rand() % 1000) / 1000.0f - 0.5f) * 0.1f;
+        trace[i] = roundf((t + fever + noise) * 40) / 40; // ~0.025C/LSB
+    }
+    return trace;
+}
+
+int main(int argc, char **argv) {
+    size_t len;
+    float *trace = (argc > 1) ? load_trace(argv[1], &len) : synth_trace(
+        len = SYNTH_LEN
+    );
+    if (!trace || !len) {
+        fprintf(stderr, "cannot load trace\n");
+        return 1;
+    }
+
+    /* storage large enough for the whole trace */
+    size_t num_blocks = len / 8 + 1; // >= 4 bytes per sample worst case
+    struct ts_block *blocks = malloc(num_blocks * sizeof(struct ts_block));
+    struct ts_store store;
+
+    /* encode throughput */
+    double t0 = now_sec();
+    for (int r = 0; r < ROUNDS; r++) {
+        ts_init(&store, blocks, num_blocks);
+        for (size_t i = 0; i < len; i++) ts_append(&store, trace[i]);
+    }
+    double t_enc = (now_sec() - t0) / ROUNDS;
+
+    /* decode throughput + round trip error */
+    double t_dec = 0, max_err = 0; size_t decoded = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        struct ts_iter it; ts_iter_init(&it, &store);
+        float v; size_t i = 0; double sum = 0;
+        t0 = now_sec();
+        while (ts_iter_next(&it, &v)) { sum += v; i++; }
+        t_dec += now_sec() - t0;
+        decoded = i;
+        if (r == 0) {
+            ts_iter_init(&it, &store);
+            for (i = 0; ts_iter_next(&it, &v); i++) {
+                if (isnan(v) != isnan(trace[i])) max_err = INFINITY;
+                else if (!isnan(v) && fabs(v - trace[i]) > max_err)
+                    max_err = fabs(v - trace[i]);
+            }
+        }
+        if (sum == 1234.5) puts(""); // keep the loop from being elided
+    }
+    t_dec /= ROUNDS;
+
+    size_t bytes = ts_bytes_used(&store);
+    printf("samples:             %zu (decoded %zu)\n", len, decoded);
+    printf("compressed:          %zu bytes (%zu blocks)\n", bytes, store.used);
+    printf("bytes/sample:        %.3f (raw float: %zu)\n",
+           (double)bytes / len, sizeof(float));
+    printf("block bytes/sample:  %.3f (incl. unused block tails)\n",
+           (double)store.used * sizeof(struct ts_block) / len);
+    printf("max round-trip err:  %.4f\n", max_err);
+    printf("encode:              %.1f Msamples/s\n", len / t_enc / 1e6);
+    printf("decode:              %.1f Msamples/s\n", len / t_dec / 1e6);
+
+    /* capacity within the firmware's history budget */
+    struct ts_block fw_blocks[RT_HISTORY_SIZE / TS_BLOCK_SIZE];
+    ts_init(&store, fw_blocks, sizeof(fw_blocks) / sizeof(struct ts_block));
+    for (size_t i = 0; i < len; i++) ts_append(&store, trace[i]);
+    printf(
+        "%d byte budget:    %zu samples (%.1f days @ %d min), float: %zu\n",
+        RT_HISTORY_SIZE, store.count,
+        store.count * RT_SENSE_PERIOD / (24.0 * 60), RT_SENSE_PERIOD,
+        RT_HISTORY_SIZE / sizeof(float)
+    );
+
+    free(blocks); free(trace);
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * uldump - decoder for record batches published by the firmware's uplink.
+ * Usage: mosquitto_sub -h <broker> -t 'bed/+/records' -F '%t %x' | uldump
+ * Each input line holds a topic and the hex-encoded batch (the topic may be
+ * omitted). Records are printed one per line as
+ *  <unit> <boot ID> <seq> <time (ms since boot)> <type> <value>
+ * Batches resent after a reconnection (same boot ID and an already seen
+ * sequence number) are skipped, and gaps (records dropped on the unit) are
+ * reported.
+ */
+
+#include "uplink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_UNITS                   64 // max tracked units
+#define MAX_LINE                    4096 // max input line length
+
+/* per-unit deduplication state */
+struct unit {
+    char name[32]; // unit name (topic level after UL_TOPIC_PREFIX)
+    uint32_t boot_id; // last seen boot ID
+    uint32_t next_seq; // next expected sequence number
+};
+
+static struct unit units[MAX_UNITS];
+static size_t num_units = 0;
+
+/*
+ * static struct unit *find_unit(const char *name)
+ *  Finds (or starts tracking) a unit.
+ *  Inputs:
+ *   - name : The unit's name.
+ *  Output: Pointer to the unit's state, or NULL if too many units are seen.
+ */
+static struct unit *find_unit(const char *name) {
+    for (size_t i = 0; i < num_units; i++) {
+        if (!strcmp(units[i].name, name)) return &units[i];
+    }
+    if (num_units == MAX_UNITS) return NULL;
+    struct unit *unit = &units[num_units++];
+    snprintf(unit->name, sizeof(unit->name), "%s", name);
+    unit->boot_id = 0; unit->next_seq = 0;
+    return unit;
+}
+
+/*
+ * static size_t unhex(const char *hex, uint8_t *buf, size_t len)
+ *  Decodes a hex string.
+ *  Inputs:
+ *   - hex : The hex string (terminated by any non-hex character).
+ *   - buf : The output buffer.
+ *   - len : The output buffer's length.
+ *  Output: The number of decoded bytes.
+ */
+static size_t unhex(const char *hex, uint8_t *buf, size_t len) {
+    size_t n = 0;
+    unsigned int byte;
+    while (n < len && sscanf(&hex[n * 2], "%2x", &byte) == 1) buf[n++] = byte;
+    return n;
+}
+
+int main() {
+    char line[MAX_LINE];
+    uint8_t batch[MAX_LINE / 2];
+
+    while (fgets(line, sizeof(line), stdin)) {
+        /* split topic and payload */
+        char name[32] = "-";
+        char *hex = strchr(line, ' ');
+        if (hex) {
+            *hex++ = '\0';
+            const char *start = line;
+            if (!strncmp(start, UL_TOPIC_PREFIX, strlen(UL_TOPIC_PREFIX)))
+                start += strlen(UL_TOPIC_PREFIX);
+            int n = strcspn(start, "/");
+            snprintf(name, sizeof(name), "%.*s", n, start);
+        } else hex = line;
+
+        size_t len = unhex(hex, batch, sizeof(batch));
+        struct ul_header header;
+        if (len < sizeof(header)) {
+            fprintf(stderr, "%s: short batch (%zu bytes)\n", name, len);
+            continue;
+        }
+        memcpy(&header, batch, sizeof(header));
+        if (header.version != UL_VERSION) {
+            fprintf(stderr, "%s: unknown version %u\n", name, header.version);
+            continue;
+        }
+        if (len < sizeof(header) + header.count * sizeof(struct ul_record)) {
+            fprintf(stderr, "%s: truncated batch\n", name);
+            continue;
+        }
+
+        /* deduplicate */
+        struct unit *unit = find_unit(name);
+        uint32_t skip = 0; // records already seen
+        if (unit) {
+            if (unit->boot_id != header.boot_id) { // unit rebooted
+                unit->boot_id = header.boot_id; unit->next_seq = header.seq;
+            }
+            if (header.seq > unit->next_seq) {
+                fprintf(
+                    stderr, "%s: %u records lost (%u dropped on unit)\n",
+                    name, header.seq - unit->next_seq, header.dropped
+                );
+            } else skip = unit->next_seq - header.seq;
+            if (header.seq + header.count > unit->next_seq)
+                unit->next_seq = header.seq + header.count;
+        }
+
+        for (uint32_t i = skip; i < header.count; i++) {
+            struct ul_record record;
+            memcpy(
+                &record, &batch[sizeof(header) + i * sizeof(record)],
+                sizeof(record)
+            );
+            printf(
+                "%s %08x %u %u %c %d\n", name, header.boot_id, header.seq + i,
+                record.time, record.type, record.value
+            );
+        }
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,445 @@
+/*
+ * wsbench - WebSocket/HTTP load generator and latency benchmark for a bed
+ * monitor unit. It can also run against tools/bedsim, but that only checks
+ * the protocol and the tool itself: bedsim does not run webserver.c, so
+ * its figures say nothing about the unit's capacity.
+ * Usage: wsbench [-h host] [-p port] [-n clients] [-d seconds] [-s sub]
+ *                [-S snapshot_ms] [-i ping_ms] [-f fetchers] [-u path]
+ *                [-r ramp_ms] [-j]
+ *  -h : Host (default 127.0.0.1).
+ *  -p : Port (default 80).
+ *  -n : Number of concurrent /ws clients (default 4).
+ *  -d : Test duration in seconds (default 30).
+ *  -s : Subscription message sent by each client (default "s:toh").
+ *  -S : Interval between history snapshot requests per client (ms, default
+ *       10000). Each request re-sends the subscription, which makes the unit
+ *       send the full T: history.
+ *  -i : Interval between WebSocket pings per client (ms, default 1000).
+ *  -f : Number of concurrent static file fetchers (default 1).
+ *  -u : Static file path (default /plot.js).
+ *  -r : Delay between client connections (ms, default 0).
+ *  -j : Report as JSON (for scripts) instead of text.
+ * Reported latencies:
+ *  - connect  : TCP connect + WebSocket handshake.
+ *  - snapshot : subscription sent to complete T: history received.
+ *  - ping     : ping to pong round trip; pongs are sent by the httpd task,
+ *               so this includes any queueing behind broadcasts.
+ *  - fanout   : arrival of a broadcast at each client relative to the first
+ *               client to receive it (delivery skew across clients).
+ *  - static   : complete static file fetch (new connection per fetch).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "ws.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS                 1024 // max -n
+#define FANOUT_SLOTS                4096 // broadcast arrival table size
+#define FANOUT_WINDOW               5000 // max fan-out skew tracked (ms)
+#define RECONNECT_DELAY             100 // delay before reconnecting (ms)
+
+/* latency sample set */
+struct samples {
+    double *v; // samples (ms)
+    size_t n; // number of samples
+    size_t cap; // capacity
+};
+
+/* latency categories */
+enum lat {
+    LAT_CONNECT = 0, LAT_SNAPSHOT, LAT_PING, LAT_FANOUT, LAT_STATIC, NUM_LATS
+};
+static const char *lat_names[NUM_LATS] = {
+    "connect", "snapshot", "ping", "fanout", "static"
+};
+
+/* counters */
+enum cnt {
+    CNT_FRAMES = 0, // WebSocket messages received
+    CNT_BYTES, // WebSocket payload bytes received
+    CNT_STATIC_FETCHES, // static files fetched
+    CNT_STATIC_BYTES, // static file bytes received
+    CNT_CONNECT_ERRORS, // failed connections/handshakes
+    CNT_DISCONNECTS, // connections dropped by the server
+    CNT_PROTOCOL_ERRORS, // malformed frames
+    CNT_STATIC_ERRORS, // failed static fetches
+    NUM_CNTS
+};
+static const char *cnt_names[NUM_CNTS] = {
+    "frames", "bytes", "static_fetches", "static_bytes",
+    "connect_errors", "disconnects", "protocol_errors", "static_errors"
+};
+
+/* broadcast arrival (for fan-out skew) */
+struct arrival {
+    uint64_t key; // broadcast key (0 if unused)
+    double first; // first arrival timestamp (ms)
+    size_t receivers; // number of clients that have received it
+};
+
+static struct samples lats[NUM_LATS];
+static uint64_t cnts[NUM_CNTS];
+static struct arrival arrivals[FANOUT_SLOTS];
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* configuration */
+static const char *host = "127.0.0.1", *port = "80";
+static const char *sub_msg = "s:toh", *static_path = "/plot.js";
+static double snapshot_interval = 10000, ping_interval = 1000;
+static size_t num_clients = 4;
+static double deadline; // end of test (ms)
+
+/*
+ * static void add_sample(enum lat lat, double value)
+ *  Records a latency sample.
+ *  Inputs:
+ *   - lat   : The latency category.
+ *   - value : The latency (ms).
+ *  Output: None.
+ */
+static void add_sample(enum lat lat, double value) {
+    pthread_mutex_lock(&stats_lock);
+    struct samples *s = &lats[lat];
+    if (s->n == s->cap) {
+        s->cap = (s->cap) ? s->cap * 2 : 1024;
+        s->v = realloc(s->v, s->cap * sizeof(double));
+    }
+    s->v[s->n++] = value;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * static void count(enum cnt cnt, uint64_t value)
+ *  Adds to a counter.
+ *  Inputs:
+ *   - cnt   : The counter.
+ *   - value : The amount to add.
+ *  Output: None.
+ */
+static void count(enum cnt cnt, uint64_t value) {
+    pthread_mutex_lock(&stats_lock);
+    cnts[cnt] += value;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * static void record_arrival(uint64_t key, double now)
+ *  Records the arrival of a broadcast at a client and the resulting fan-out
+ *  skew. A broadcast is complete once every client has received it, so a
+ *  later broadcast with identical contents is treated as a new one.
+ *  Inputs:
+ *   - key : Key identifying the broadcast (non-zero).
+ *   - now : The arrival timestamp (ms).
+ *  Output: None.
+ */
+static void record_arrival(uint64_t key, double now) {
+    pthread_mutex_lock(&stats_lock);
+    struct arrival *slot = &arrivals[key % FANOUT_SLOTS];
+    double skew = 0;
+    if (
+            slot->key == key && slot->receivers < num_clients
+        &&  now - slot->first < FANOUT_WINDOW
+    ) {
+        skew = now - slot->first;
+        slot->receivers++;
+    } else *slot = (struct arrival){ key, now, 1 }; // first arrival
+    pthread_mutex_unlock(&stats_lock);
+    add_sample(LAT_FANOUT, skew);
+}
+
+/*
+ * static uint64_t frame_key(const struct ws_frame *msg)
+ *  Derives a key identifying a broadcast from its contents. Scope frames are
+ *  identified by their sequence numbers, other messages by an FNV-1a hash
+ *  of their payload.
+ *  Inputs:
+ *   - msg : The message.
+ *  Output: The key (non-zero).
+ */
+static uint64_t frame_key(const struct ws_frame *msg) {
+    const uint8_t *p = msg->payload;
+    if (msg->opcode == WS_OP_BINARY && msg->len >= 8 && p[0] == 'f') {
+        uint32_t seq =
+            p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+        return ((uint64_t)'f' << 56) | (1ULL << 32) | seq;
+    }
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < msg->len; i++)
+        hash = (hash ^ msg->payload[i]) * 0x100000001B3ULL;
+    return hash | 1;
+}
+
+/*
+ * static void *client_thread(void *arg)
+ *  Runs a WebSocket client until the end of the test, reconnecting whenever
+ *  the connection is lost.
+ *  Inputs:
+ *   - arg : Unused.
+ *  Output: NULL.
+ */
+static void *client_thread(void *arg) {
+    (void) arg;
+    struct ws_conn conn;
+
+    while (now_ms() < deadline) {
+        double start = now_ms();
+        if (ws_client_open(&conn, host, port, "/ws")) {
+            count(CNT_CONNECT_ERRORS, 1);
+            usleep(RECONNECT_DELAY * 1000);
+            continue;
+        }
+        add_sample(LAT_CONNECT, now_ms() - start);
+
+        double sub_sent = now_ms(), last_ping = 0;
+        bool waiting = true; // waiting for snapshot
+        ws_send(&conn, WS_OP_TEXT, sub_msg, strlen(sub_msg));
+
+        while (true) {
+            double now = now_ms();
+            if (now >= deadline) break;
+            if (now - last_ping >= ping_interval) {
+                last_ping = now;
+                ws_send(&conn, WS_OP_PING, &now, sizeof(now));
+            }
+            if (!waiting && now - sub_sent >= snapshot_interval) {
+                sub_sent = now; waiting = true;
+                ws_send(&conn, WS_OP_TEXT, sub_msg, strlen(sub_msg));
+            }
+
+            int ret = ws_fill(&conn, 20);
+            if (ret < 0) {
+                count(CNT_DISCONNECTS, 1);
+                break;
+            }
+
+            struct ws_frame msg;
+            bool closed = false;
+            now = now_ms();
+            while ((ret = ws_next(&conn, &msg)) > 0) {
+                if (msg.opcode == WS_OP_PONG && msg.len == sizeof(double)) {
+                    double sent; memcpy(&sent, msg.payload, sizeof(sent));
+                    add_sample(LAT_PING, now - sent);
+                    continue;
+                }
+                if (msg.opcode == WS_OP_CLOSE) {
+                    closed = true;
+                    break;
+                }
+                if (msg.opcode & 0x8) continue; // other control frames
+
+                count(CNT_FRAMES, 1); count(CNT_BYTES, msg.len);
+                if (msg.len >= 2 && !memcmp(msg.payload, "T:", 2)) {
+                    if (waiting) {
+                        waiting = false;
+                        add_sample(LAT_SNAPSHOT, now - sub_sent);
+                    }
+                } else record_arrival(frame_key(&msg), now);
+            }
+            if (closed || ret < 0) {
+                count((closed) ? CNT_DISCONNECTS : CNT_PROTOCOL_ERRORS, 1);
+                break;
+            }
+        }
+
+        ws_conn_close(&conn);
+    }
+
+    return NULL;
+}
+
+/*
+ * static void *static_thread(void *arg)
+ *  Repeatedly fetches the static file until the end of the test.
+ *  Inputs:
+ *   - arg : Unused.
+ *  Output: NULL.
+ */
+static void *static_thread(void *arg) {
+    (void) arg;
+    char buf[16384];
+
+    while (now_ms() < deadline) {
+        double start = now_ms();
+        int fd = tcp_connect(host, port);
+        if (fd < 0) {
+            count(CNT_STATIC_ERRORS, 1);
+            usleep(RECONNECT_DELAY * 1000);
+            continue;
+        }
+
+        int len = snprintf(
+            buf, sizeof(buf),
+            "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n",
+            static_path, host
+        );
+        size_t body = 0, expected = 0, value_len;
+        const char *value;
+        bool ok =
+                send(fd, buf, len, MSG_NOSIGNAL) == len
+            &&  http_read_head(fd, buf, sizeof(buf)) > 0
+            &&  !strncmp(buf, "HTTP/1.1 200", 12)
+            &&  (value = http_header(buf, "Content-Length", &value_len));
+        if (ok) {
+            expected = strtoul(value, NULL, 10);
+            ssize_t ret;
+            while (body < expected && (ret = recv(fd, buf, sizeof(buf), 0)) > 0)
+                body += ret;
+            ok = body == expected;
+        }
+        close(fd);
+
+        if (ok) {
+            add_sample(LAT_STATIC, now_ms() - start);
+            count(CNT_STATIC_FETCHES, 1); count(CNT_STATIC_BYTES, body);
+        } else {
+            count(CNT_STATIC_ERRORS, 1);
+            usleep(RECONNECT_DELAY * 1000);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * static int compare(const void *a, const void *b)
+ *  Comparison function for sorting samples.
+ *  Inputs:
+ *   - a : Pointer to the first sample.
+ *   - b : Pointer to the second sample.
+ *  Output: <0, 0 or >0 if a is less than, equal to or greater than b.
+ */
+static int compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * static double percentile(const struct samples *s, double p)
+ *  Retrieves a percentile of a (sorted) sample set.
+ *  Inputs:
+ *   - s : The sample set.
+ *   - p : The percentile (0-100).
+ *  Output: The percentile value, or 0 if there are no samples.
+ */
+static double percentile(const struct samples *s, double p) {
+    if (!s->n) return 0;
+    size_t i = (size_t)(p / 100 * (s->n - 1) + 0.5);
+    return s->v[i];
+}
+
+int main(int argc, char **argv) {
+    size_t num_fetchers = 1;
+    double duration = 30, ramp = 0;
+    bool json = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:n:d:s:S:i:f:u:r:j")) != -1) {
+        switch (opt) {
+            case 'h': host = optarg; break;
+            case 'p': port = optarg; break;
+            case 'n': num_clients = strtoul(optarg, NULL, 10); break;
+            case 'd': duration = strtod(optarg, NULL); break;
+            case 's': sub_msg = optarg; break;
+            case 'S': snapshot_interval = strtod(optarg, NULL); break;
+            case 'i': ping_interval = strtod(optarg, NULL); break;
+            case 'f': num_fetchers = strtoul(optarg, NULL, 10); break;
+            case 'u': static_path = optarg; break;
+            case 'r': ramp = strtod(optarg, NULL); break;
+            case 'j': json = true; break;
+            default:
+                fprintf(
+                    stderr, "usage: %s [-h host] [-p port] [-n clients] "
+                    "[-d seconds] [-s sub] [-S snapshot_ms] [-i ping_ms] "
+                    "[-f fetchers] [-u path] [-r ramp_ms] [-j]\n", argv[0]
+                );
+                return 1;
+        }
+    }
+    if (num_clients > MAX_CLIENTS) num_clients = MAX_CLIENTS;
+
+    pthread_t threads[MAX_CLIENTS * 2];
+    size_t num_threads = 0;
+    double start = now_ms();
+    deadline = start + duration * 1000 + ramp * num_clients;
+    for (size_t i = 0; i < num_clients; i++) {
+        pthread_create(&threads[num_threads++], NULL, client_thread, NULL);
+        if (ramp > 0) usleep(ramp * 1000);
+    }
+    for (size_t i = 0; i < num_fetchers && i < MAX_CLIENTS; i++)
+        pthread_create(&threads[num_threads++], NULL, static_thread, NULL);
+    for (size_t i = 0; i < num_threads; i++) pthread_join(threads[i], NULL);
+    double elapsed = (now_ms() - start) / 1000;
+
+    /* report */
+    for (size_t i = 0; i < NUM_LATS; i++)
+        qsort(lats[i].v, lats[i].n, sizeof(double), compare);
+    if (json) {
+        printf(
+            "{\"clients\":%zu,\"fetchers\":%zu,\"duration_s\":%.3f,"
+            "\"latency_ms\":{", num_clients, num_fetchers, elapsed
+        );
+        for (size_t i = 0; i < NUM_LATS; i++) {
+            printf(
+                "%s\"%s\":{\"n\":%zu,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,"
+                "\"max\":%.3f}", (i) ? "," : "", lat_names[i], lats[i].n,
+                percentile(&lats[i], 50), percentile(&lats[i], 90),
+                percentile(&lats[i], 99), percentile(&lats[i], 100)
+            );
+        }
+        printf("},\"counts\":{");
+        for (size_t i = 0; i < NUM_CNTS; i++) {
+            printf(
+                "%s\"%s\":%llu", (i) ? "," : "", cnt_names[i],
+                (unsigned long long)cnts[i]
+            );
+        }
+        printf(
+            "},\"frames_per_s\":%.2f,\"ws_kbps\":%.2f,\"static_kbps\":%.2f}\n",
+            cnts[CNT_FRAMES] / elapsed, cnts[CNT_BYTES] * 8e-3 / elapsed,
+            cnts[CNT_STATIC_BYTES] * 8e-3 / elapsed
+        );
+    } else {
+        printf(
+            "%zu clients, %zu fetchers, %.1f s against %s:%s\n\n",
+            num_clients, num_fetchers, elapsed, host, port
+        );
+        printf(
+            "%-10s %8s %10s %10s %10s %10s\n",
+            "latency", "n", "p50 ms", "p90 ms", "p99 ms", "max ms"
+        );
+        for (size_t i = 0; i < NUM_LATS; i++) {
+            printf(
+                "%-10s %8zu %10.2f %10.2f %10.2f %10.2f\n", lat_names[i],
+                lats[i].n, percentile(&lats[i], 50),
+                percentile(&lats[i], 90), percentile(&lats[i], 99),
+                percentile(&lats[i], 100)
+            );
+        }
+        printf("\n");
+        for (size_t i = 0; i < NUM_CNTS; i++) {
+            printf(
+                "%-16s %llu\n", cnt_names[i], (unsigned long long)cnts[i]
+            );
+        }
+        printf(
+            "\nthroughput: %.1f frames/s, %.1f kbit/s WebSocket, "
+            "%.1f kbit/s static\n",
+            cnts[CNT_FRAMES] / elapsed, cnts[CNT_BYTES] * 8e-3 / elapsed,
+            cnts[CNT_STATIC_BYTES] * 8e-3 / elapsed
+        );
+    }
+
+    /* non-zero exit status if anything failed, for scripted runs */
+    return (
+            cnts[CNT_CONNECT_ERRORS] || cnts[CNT_DISCONNECTS]
+        ||  cnts[CNT_PROTOCOL_ERRORS] || cnts[CNT_STATIC_ERRORS]
+    ) ? 2 : 0;
+}